@@ -0,0 +1,37 @@
+#ifndef ANALYSIS_TREE_H
+#define ANALYSIS_TREE_H
+
+#include <Rtypes.h>
+
+#include "WaveformAnalysis.h"
+
+class TTree;
+
+// analysis_tree: one entry per analyzed (evtn, det, ch), shared by
+// analyze_waveforms and rfsoc_ridf_analyzer --analyze
+struct AnalysisTreeOutput {
+  TTree *tree = nullptr;
+  Int_t evtn = 0;
+  Int_t det = 0;
+  Int_t ch = 0;
+  Int_t nsample = 0;
+  Float_t baseline = 0.0f;
+  Float_t baseline_rms = 0.0f;
+  Float_t amplitude = 0.0f;
+  Int_t peak_sample = -1;
+  Float_t peak_time_ns = -1.0f;
+  Float_t cfd_time_ns = -1.0f;
+  Float_t cfd[9] = {-1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f};
+  Float_t dcfd_time_ns = -1.0f;
+  Float_t dcfd[9] = {-1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f};
+  Float_t risetime = 0.0f;
+  Bool_t valid = false;
+  Long64_t filled_bytes = 0;  // uncompressed bytes passed to Fill
+};
+
+// Create analysis_tree in the current directory
+void createAnalysisTree(AnalysisTreeOutput &out);
+void fillAnalysisTree(AnalysisTreeOutput &out, int evtn, int det, int ch, int nsample,
+                      const WaveformAnalysisResult &result);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef __C16UNPACK__
+#define __C16UNPACK__
+
+/** Per-segment statistics of unpacked C16 samples */
+struct c16_stats{
+  short min;            ///< Minimum sample
+  short max;            ///< Maximum sample
+  long long sum;        ///< Sum of samples
+  long long sumsq;      ///< Sum of squared samples
+};
+
+/**
+ * @fn
+ * @brief  : unpack C16 words (12-bit ADC in the upper bits, raw >> 4 with
+ *           sign extension) and get min/max/sum in the same pass.
+ *           Vectorized with AVX2/SSE2 when available (runtime dispatch).
+ * @raw    : in  : raw 16-bit words of the segment
+ * @n      : in  : number of samples
+ * @wf     : out : unpacked samples (n entries)
+ * @hist   : out : 4096-bin ADC count array indexed by sample+2048, NULL = not counted
+ * @st     : out : statistics (min=32767, max=-32768 if n=0)
+ */
+void c16_unpack_stats(const unsigned short *raw, int n, short *wf,
+		      unsigned int *hist, struct c16_stats *st);
+
+/**
+ * @fn
+ * @brief  : same statistics for samples which are already unpacked
+ */
+void c16_sample_stats(const short *wf, int n, unsigned int *hist, struct c16_stats *st);
+
+/**
+ * @fn
+ * @return : name of the selected c16_unpack_stats implementation
+ *           ("avx2", "sse2" or "scalar")
+ */
+const char *c16_unpack_impl(void);
+
+/**
+ * @fn
+ * @brief  : force an implementation (for benchmarks and cross checks)
+ * @name   : in  : "avx2", "sse2" or "scalar"
+ * @return : 0=normal, -1=not supported on this CPU/build
+ */
+int c16_unpack_select(const char *name);
+
+#endif
@@ -8,6 +8,23 @@ public:
   virtual ~ModuleAbst(){}
 
   virtual int decode(char *ptr, int sz, int data[4]);
+
+  /**
+   * @fn
+   * @brief  : clear the decode position before a new segment,
+   *           so one instance can be reused for every segment
+   */
+  virtual void reset();
+
+  /**
+   * @fn
+   * @brief  : view of the whole segment content as 16-bit samples (zero-copy)
+   * @ptr    : in  : segment content
+   * @sz     : in  : size of segment content
+   * @n      : out : number of samples
+   * @return : pointer of first sample, NULL=module data is not a 16-bit sample array
+   */
+  virtual const unsigned short *samples(char *ptr, int sz, int *n);
   virtual void test() = 0;
 
   ClassDef(ModuleAbst, 1);
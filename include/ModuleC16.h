@@ -7,6 +7,8 @@ class ModuleC16 : public ModuleAbst {
 public:
   ModuleC16();
   int decode(char *ptr, int sz, int data[4]);
+  const unsigned short *samples(char *ptr, int sz, int *n);
+  void reset();
   void test();
 
   ClassDef(ModuleC16, 1);
@@ -5,6 +5,17 @@
 #include "ModuleAbst.h"
 #include "RIDFPull.h"
 
+class RIDFPrefetch;
+class RIDFPullMux;
+
+/** Entry of the sidecar event index (.ridx) */
+struct ridx_entry{
+  long long blkoff;        ///< File offset of the block
+  int idx;                 ///< Offset of the event header in the block
+  unsigned int evtn;       ///< Event number
+  unsigned long long ts;   ///< Timestamp (0 if no ts event header)
+};
+
 class RIDFParser{
 public:
   RIDFParser();
@@ -54,7 +65,99 @@ public:
   char* getsegbuff(char *buff, int sidx, int *ssz);
 
   int file(const char *file);
+
+  /**
+   * @fn
+   * @brief  : open RIDF file as read-only memory mapping (zero-copy)
+   * @file   : in  : file path
+   * @return : 1=normal, -1=cannot open or map file
+   */
+  int mapfile(const char *file);
+
+  /**
+   * @fn
+   * @brief  : online mode, pull blocks from babinfo
+   * @host   : in  : babinfo host, or comma separated hosts which are
+   *                 received on one thread per host and merged
+   * @return : number of hosts
+   */
   int online(const char *host);
+
+  /**
+   * @fn
+   * @return : source id (index in the online host list) of the current block,
+   *           0 for file input or a single host
+   */
+  int blocksource(void){ return gsrc; }
+  int nsource(void);
+  const char *sourcename(int src);
+
+  /**
+   * @fn
+   * @brief  : receiver statistics of an online host
+   * @return : 0=normal, -1=invalid source id or not online
+   */
+  int sourcestats(int src, struct ridfpull_stats *st);
+
+  /**
+   * @fn
+   * @brief  : read blocks of the file opened by file() on a background thread
+   * @nbuf   : in  : number of ring buffers (>= 2), 0 = disable
+   * @return : 1=enabled, 0=disabled or not a stdio file input
+   */
+  int prefetch(int nbuf);
+
+  /**
+   * @fn
+   * @brief  : scan the opened file and build the event index in memory
+   * @return : number of indexed events, -1=no file input
+   */
+  int buildindex(void);
+
+  /**
+   * @fn
+   * @brief  : read/write the event index from/to a .ridx file
+   * @path   : in  : index file path
+   * @return : number of indexed events, -1=error or stale index
+   */
+  int loadindex(const char *path);
+  int saveindex(const char *path);
+
+  /**
+   * @fn
+   * @brief  : load <file>.ridx next to the opened file, or build and save it
+   * @return : number of indexed events, -1=no file input
+   */
+  int useindex(void);
+
+  /**
+   * @fn
+   * @brief  : move to the first event whose event number is >= evtn,
+   *           next nextevt() returns that event (uses the event index)
+   * @evtn   : in  : event number
+   * @return : 0=normal, -1=no index or no such event
+   */
+  int seekevt(int evtn);
+
+  /**
+   * @fn
+   * @brief  : header-only scan of the block boundaries of the opened file
+   * @nblk   : out : number of blocks
+   * @return : malloced array of block offsets (free by caller), NULL=no file input
+   */
+  long long *scanblocks(int *nblk);
+
+  /**
+   * @fn
+   * @brief  : read the block at a file offset without moving the input
+   *           position, safe to call from several threads
+   * @off    : in  : file offset of the block
+   * @buff   : in  : 1 MB buffer used for stdio input (not used with mmap)
+   * @blk    : out : pointer of the block (into buff or into the mapping)
+   * @return : block size, -1=error or end of file
+   */
+  int readblockat(long long off, char *buff, char **blk);
+
   char* nextevtdata(int *evtn, int *idx, int *sz, int *flag);
   int close(void);
   int rewindfile(void);
@@ -63,6 +166,33 @@ public:
   void showsegid(void);
   int getgblock();
 
+  /**
+   * @fn
+   * @brief  : block number of the block-number chunk (cid 8) following the
+   *           block header
+   * @buff   : in  : block data
+   * @sz     : in  : block size
+   * @return : block number, -1=no block-number chunk
+   */
+  int getblkn(char *buff, int sz);
+
+  /**
+   * @fn
+   * @brief  : current block: block number (-1=none), size in bytes and
+   *           number of blocks read since the input was opened
+   */
+  int blocknumber(void){ return gblkn; }
+  int blocksize(void){ return gblksz; }
+  long long blockcount(void){ return gblkcnt; }
+
+  /**
+   * @fn
+   * @brief  : get next block from the mapped file
+   * @blk    : out : pointer of block head in the mapping
+   * @return : block size, -1=end of file or truncated block
+   */
+  int getmapblock(char **blk);
+
   /**
    * @fn
    * @evtn   : event number
@@ -70,6 +200,16 @@ public:
    */
   int nextevt(int *evtn);
 
+  /**
+   * @fn
+   * @brief  : read the next whole block (file, mapping or online) for callers
+   *           that walk the events themselves with getevtindex(); the event
+   *           walk of nextevt() restarts at the following block
+   * @blk    : out : pointer of block, valid until the next read
+   * @return : block size, 0=no new online data, -1=end of data or error
+   */
+  int nextblock(char **blk);
+
   /**
    * @fn
    * @segid  : segment id
@@ -85,6 +225,27 @@ public:
    */
   int nextdata(int segid, int data[4]);
 
+  /**
+   * @fn
+   * @brief  : register the decoder of a module id, the parser owns it and
+   *           reuses the same instance (reset()) for every segment.
+   *           Module 0 (C16) is registered by default.
+   * @mod    : in  : module id (lower 8 bit of segment id)
+   * @dec    : in  : decoder instance, NULL = no decoder (raw 32bit values)
+   * @return : 0=normal, -1=invalid module id
+   */
+  int setdecoder(int mod, ModuleAbst *dec);
+  ModuleAbst *getdecoder(int mod);
+
+  /**
+   * @fn
+   * @brief  : whole content of the segment selected by nextseg() as 16-bit
+   *           samples, zero-copy view valid until the next block is read
+   * @n      : out : number of samples
+   * @return : pointer of first sample, NULL=no 16-bit sample decoder for this module
+   */
+  const unsigned short *segdata(int *n);
+
   int mksegid(int dev, int fp, int det, int mod){
     return (0x3f & dev) << 20 | (0x3f & fp) << 14 |(0x3f & det) << 8 | mod;
   }
@@ -107,12 +268,32 @@ private:
   int gevtn{0};
   unsigned long long int gts{0};
   char *gbuff{NULL};
+  char *gblk{NULL};
   FILE *gfd{NULL};
+  char *gmap{NULL};
+  long long gmapsz{0};
+  long long gmapoff{0};
   int  *seglist{NULL};
-  char gline[256]{0};
-  char fpath[128]{0};
+  char gline[1040]{0};
+  char fpath[1024]{0};
   ModuleAbst *decoder{NULL};
+  ModuleAbst *decoders[256]{}; //!
   RIDFPull *puller{NULL};
+  RIDFPullMux *pullmux{NULL}; //!
+  int gsrc{0};
+  int gblkn{-1};
+  int gblksz{0};
+  long long gblkcnt{0};
+  RIDFPrefetch *prefetcher{NULL}; //!
+  struct ridx_entry *gindex{NULL}; //!
+  int gnindex{0};
+  int gindexsorted{0};
+
+  int unmapfile(void);
+  int stopprefetch(void);
+  int freeindex(void);
+  int closeonline(void);
+  int readgblock(void);
 
 };
 
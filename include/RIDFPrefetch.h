@@ -0,0 +1,63 @@
+#ifndef __RIDFPREFETCH__
+#define __RIDFPREFETCH__
+
+#include <stdio.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/**
+ * Background block reader.
+ * A reader thread fills a ring of block buffers ahead of the parser.
+ * The consumer keeps the block returned by next() until the following
+ * next() call, so at least two buffers (double buffering) are needed.
+ * The reader waits while all free buffers are filled (back-pressure).
+ */
+class RIDFPrefetch{
+ public:
+  /**
+   * @reader : in : function that reads one block into the buffer and
+   *                returns its size (<= 0 means end of data)
+   * @nbuf   : in : number of ring buffers (>= 2)
+   * @bufsz  : in : size of each buffer
+   */
+  RIDFPrefetch(std::function<int(char *)> reader, int nbuf, int bufsz);
+  virtual ~RIDFPrefetch();
+
+  int start(void);
+  int stop(void);
+
+  /**
+   * @fn
+   * @brief  : release the previous block and wait for the next one
+   * @blk    : out : pointer of block buffer
+   * @return : block size, -1=end of data
+   */
+  int next(char **blk);
+
+  /**
+   * @fn
+   * @return : number of blocks read ahead and not consumed yet
+   */
+  int depth(void);
+
+private:
+  void run(void);
+
+  std::function<int(char *)> rfunc;
+  char **bufs{NULL};
+  int *sizes{NULL};
+  int nbuf{0};
+  int bufsz{0};
+  int head{0};
+  int count{0};
+  int held{0};
+  int eof{0};
+  int quit{0};
+  std::thread *th{NULL};
+  std::mutex mtx;
+  std::condition_variable cv;
+};
+
+#endif
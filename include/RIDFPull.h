@@ -3,22 +3,46 @@
 
 #include <TObject.h>
 
+/** Receiver statistics of one babinfo host */
+struct ridfpull_stats{
+  long long polls;         ///< pull() calls
+  long long blocks;        ///< New blocks received
+  long long bytes;         ///< Bytes of new blocks
+  long long skipped;       ///< Blocks missed between two polls (block number gaps)
+  int errors;              ///< Failed polls (no connection, short reply)
+  int reconnects;          ///< New TCP connections after the first one
+  int connected;           ///< 1 if the last poll succeeded
+};
+
 class RIDFPull{
  public:
   RIDFPull(std::string host);
   virtual ~RIDFPull();
   int mktcpsend(char *host, unsigned short port);
-  int eb_get(int sock, int com, char *dest);
+  int eb_get(int sock, int com, char *dest, int maxlen);
   int infcon(char *host);
-  int pull(char *data);
+  int pull(char *data, int bufsz);
+  void disconnect(void);
+  const char *hostname(void){ return ebhostname; }
+  void getstats(struct ridfpull_stats *st){ *st = stats; }
 
-  ClassDef(RIDFPull, 1);
+  ClassDef(RIDFPull, 2);
 
 private:
+  int connectinf(void);
+  int command(int com, char *dest, int maxlen);
+
   int sock{0};
   //char *data{NULL};
   char ebhostname[128]{0};
   int blkn{0};
+  int blknok{0};           // blkn holds a received block number
+  unsigned int ebaddr{0};   // resolved babinfo address (network order)
+  int ebresolved{0};
+  int infblkn{0};           // last INF_GET_BLOCKNUM answer
+  int infblknok{0};
+  int nconnect{0};
+  struct ridfpull_stats stats{}; //!
 };
 
 
@@ -0,0 +1,80 @@
+#ifndef __RIDFPULLMUX__
+#define __RIDFPULLMUX__
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "RIDFPull.h"
+
+/**
+ * Online receiver for several babinfo hosts.
+ * Each host has its own RIDFPull and receiver thread. New blocks go
+ * into one shared pool of buffers and are handed to the parser in
+ * arrival order, tagged with the index of their host (source id).
+ * A host that cannot be reached is retried once per second without
+ * stopping the others.
+ */
+class RIDFPullMux{
+ public:
+  /**
+   * @nbuf   : in : number of shared block buffers (>= number of hosts + 1)
+   * @bufsz  : in : size of each buffer
+   */
+  RIDFPullMux(int nbuf, int bufsz);
+  virtual ~RIDFPullMux();
+
+  /**
+   * @fn
+   * @brief  : add a host before start()
+   * @return : source id of the host
+   */
+  int addhost(const char *host);
+  int nhost(void){ return (int)pullers.size(); }
+  const char *hostname(int src);
+
+  int start(void);
+  int stop(void);
+
+  /**
+   * @fn
+   * @brief  : release the previous block and take the oldest received one,
+   *           does not wait
+   * @blk    : out : pointer of block buffer
+   * @src    : out : source id of the block
+   * @return : block size, 0=no block received yet
+   */
+  int next(char **blk, int *src);
+
+  /**
+   * @fn
+   * @return : 0=normal, -1=invalid source id
+   */
+  int getstats(int src, struct ridfpull_stats *st);
+
+  /**
+   * @fn
+   * @return : number of received blocks not consumed yet
+   */
+  int depth(void);
+
+private:
+  void run(int src);
+
+  std::vector<RIDFPull *> pullers;
+  std::vector<struct ridfpull_stats> hoststats;
+  std::vector<std::thread *> threads;
+  std::vector<char *> bufs;
+  std::vector<int> sizes;
+  std::vector<int> srcs;
+  std::vector<int> freebufs;
+  std::deque<int> ready;
+  int bufsz{0};
+  int held{-1};
+  int quit{0};
+  std::mutex mtx;
+  std::condition_variable cv;
+};
+
+#endif
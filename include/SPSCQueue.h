@@ -0,0 +1,61 @@
+#ifndef __SPSCQUEUE__
+#define __SPSCQUEUE__
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/**
+ * Bounded lock-free single-producer/single-consumer queue.
+ * try_push() may only be called from one thread and try_pop() from one
+ * other thread. Neither call blocks; a full or empty queue returns false
+ * and the caller decides whether to drop, retry or back off.
+ */
+template <typename T>
+class SPSCQueue {
+ public:
+  explicit SPSCQueue(size_t capacity) : slots_(capacity + 1) {}
+
+  SPSCQueue(const SPSCQueue &) = delete;
+  SPSCQueue &operator=(const SPSCQueue &) = delete;
+
+  bool try_push(T &&value) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t next = increment(tail);
+    if (next == head_.load(std::memory_order_acquire)) {
+      return false;  // full
+    }
+    slots_[tail] = std::move(value);
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  bool try_pop(T &value) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;  // empty
+    }
+    value = std::move(slots_[head]);
+    head_.store(increment(head), std::memory_order_release);
+    return true;
+  }
+
+  // Approximate when called while the other side is running
+  size_t size() const {
+    const size_t head = head_.load(std::memory_order_acquire);
+    const size_t tail = tail_.load(std::memory_order_acquire);
+    return (tail + slots_.size() - head) % slots_.size();
+  }
+
+  size_t capacity() const { return slots_.size() - 1; }
+
+ private:
+  size_t increment(size_t i) const { return (i + 1 == slots_.size()) ? 0 : i + 1; }
+
+  std::vector<T> slots_;
+  alignas(64) std::atomic<size_t> head_{0};  // consumer position
+  alignas(64) std::atomic<size_t> tail_{0};  // producer position
+};
+
+#endif
@@ -5,6 +5,7 @@
 #include <map>
 #include <optional>
 #include <string>
+#include <vector>
 
 enum class SignalPolarity { Positive = 1, Negative = -1 };
 
@@ -24,6 +25,10 @@ struct ConfigNode {
   std::optional<bool> store_cfd_array;
   std::optional<bool> store_dcfd_array;
   std::optional<double> dcfd_fraction;
+  std::optional<bool> zero_suppression;
+  std::optional<double> zs_nsigma;
+  std::optional<int> roi_pre;
+  std::optional<int> roi_post;
 };
 
 struct DetectorConfigNode {
@@ -50,6 +55,63 @@ struct ResolvedAnalysisParams {
   std::string dcfd_store_mode = "single";
   int cfd_target_percent = 50;
   int dcfd_target_percent = 30;
+  // conversion-time suppression (rfsoc_ridf_analyzer --suppress)
+  bool zero_suppression = false;
+  double zs_nsigma = 3.0;
+  int roi_pre = 0;
+  int roi_post = 0;
+};
+
+enum class StoreMode { Single, Array };
+
+// ResolvedAnalysisParams after sanitizing, reduced to what the per-waveform
+// code reads: no strings, polarity as a sign, target fractions precomputed
+struct CompiledAnalysisParams {
+  bool valid = true; // false: sample_rate_ns <= 0, every result is invalid
+  bool enabled = true;
+  double sample_rate_ns = 2.0;
+  SignalPolarity polarity = SignalPolarity::Negative;
+  double sign = -1.0;
+  int baseline_start = 0;
+  int baseline_end = 50;
+  int ma_window_size = 1;
+  bool dcfd_enabled = false;
+  int dcfd_delay = 3;
+  StoreMode cfd_store_mode = StoreMode::Array;
+  StoreMode dcfd_store_mode = StoreMode::Single;
+  int cfd_target_index = 4; // into cfd_times (10% steps)
+  double cfd_target_fraction = 0.5;
+  double dcfd_target_fraction = 0.3;
+  bool zero_suppression = false;
+  double zs_nsigma = 3.0;
+  int roi_pre = 0;
+  int roi_post = 0;
+};
+
+// Resolved parameters of every (det, ch) in a flat array, built once per
+// config. Detectors 0-63 and those named in the config have their own rows
+// (channels 0-7, plus one row for other channels); other detectors share the
+// detectors.default row.
+class AnalysisParamTable {
+public:
+  void compile(const AnalysisConfig &config);
+
+  const CompiledAnalysisParams &compiled(int det, int ch) const { return compiled_[index(det, ch)]; }
+  const ResolvedAnalysisParams &resolved(int det, int ch) const { return resolved_[index(det, ch)]; }
+
+private:
+  static constexpr int kRowSize = 9;
+
+  size_t index(int det, int ch) const {
+    if (det < 0 || det >= ndet_) {
+      return static_cast<size_t>(ndet_) * kRowSize;
+    }
+    return static_cast<size_t>(det) * kRowSize + ((ch >= 0 && ch < kRowSize - 1) ? ch : kRowSize - 1);
+  }
+
+  int ndet_ = 0;
+  std::vector<CompiledAnalysisParams> compiled_ = std::vector<CompiledAnalysisParams>(1);
+  std::vector<ResolvedAnalysisParams> resolved_ = std::vector<ResolvedAnalysisParams>(1);
 };
 
 struct WaveformAnalysisResult {
@@ -77,7 +139,38 @@ bool loadAnalysisConfig(const std::string &path, AnalysisConfig &config, std::st
 
 ResolvedAnalysisParams resolveAnalysisParams(const AnalysisConfig &config, int det, int ch);
 bool validateBaselineRange(const ResolvedAnalysisParams &params, int nsample);
+CompiledAnalysisParams compileAnalysisParams(const ResolvedAnalysisParams &params);
 
 WaveformAnalysisResult analyzeWaveform(const short *wf, int nsample, const ResolvedAnalysisParams &params);
+WaveformAnalysisResult analyzeWaveform(const short *wf, int nsample, const CompiledAnalysisParams &params);
+
+// Work buffers of analyzeWaveform. Keep one per thread and pass it to every
+// call: the buffers only grow, so the analysis does not allocate.
+struct WaveformScratch {
+  std::vector<double> normalized;
+  std::vector<double> ring; // moving average history
+};
+
+WaveformAnalysisResult analyzeWaveform(const short *wf, int nsample, const CompiledAnalysisParams &params,
+                                       WaveformScratch &scratch);
+
+// Move sample indices and times of a result analyzed on a cropped waveform
+// (first sample = sample_offset) back to the frame of the full waveform
+void shiftAnalysisResult(WaveformAnalysisResult &result, int sample_offset, const ResolvedAnalysisParams &params);
+
+struct SuppressionDecision {
+  bool keep = true;
+  int crop_start = 0;
+  int crop_length = 0;
+};
+
+// Zero suppression and region of interest: baseline/RMS over the baseline
+// window, drop the waveform without a zs_nsigma excursion in the signal
+// polarity, keep [peak - roi_pre, peak + roi_post) if roi_post > 0. The crop
+// always holds baseline_end samples, before the peak when the trace allows
+// (roi_pre is raised to baseline_end), so the baseline window still applies
+// to the stored samples.
+SuppressionDecision evaluateSuppression(const short *wf, int nsample, const ResolvedAnalysisParams &params);
+SuppressionDecision evaluateSuppression(const short *wf, int nsample, const CompiledAnalysisParams &params);
 
 #endif
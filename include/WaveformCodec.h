@@ -0,0 +1,146 @@
+#ifndef WAVEFORM_CODEC_H
+#define WAVEFORM_CODEC_H
+
+// Compact waveform encoding for the wftree "wfpk" column.
+//
+// Layout of one encoded waveform of n samples (n is stored separately):
+//   int16   first sample (little endian)
+//   blocks of 16 deltas wf[i] - wf[i-1] (16-bit wrap-around), zigzag coded:
+//     uint8   bit width w (0-16)
+//     2*w     bytes, the 16 values packed LSB first (the last block is
+//             padded with zeros)
+// The 12-bit ADC traces typically need 3-6 bits per sample.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+constexpr int kWaveformCodecBlock = 16;
+
+inline size_t waveformCodecMaxBytes(int nsample) {
+  if (nsample <= 0) {
+    return 0;
+  }
+  const size_t nblock = (static_cast<size_t>(nsample - 1) + kWaveformCodecBlock - 1) / kWaveformCodecBlock;
+  return 2 + nblock * (1 + 2 * kWaveformCodecBlock);
+}
+
+// Encode nsample samples into out (at least waveformCodecMaxBytes(nsample)
+// bytes); returns the encoded size
+inline size_t encodeWaveform(const short *wf, int nsample, unsigned char *out) {
+  if (nsample <= 0) {
+    return 0;
+  }
+  const uint16_t first = static_cast<uint16_t>(wf[0]);
+  out[0] = static_cast<unsigned char>(first & 0xff);
+  out[1] = static_cast<unsigned char>(first >> 8);
+  size_t pos = 2;
+
+  for (int b = 1; b < nsample; b += kWaveformCodecBlock) {
+    uint16_t zz[kWaveformCodecBlock] = {};
+    uint16_t any = 0;
+    const int n = (nsample - b < kWaveformCodecBlock) ? nsample - b : kWaveformCodecBlock;
+    for (int i = 0; i < n; i++) {
+      const int16_t d = static_cast<int16_t>(static_cast<uint16_t>(wf[b + i]) - static_cast<uint16_t>(wf[b + i - 1]));
+      zz[i] = static_cast<uint16_t>((static_cast<uint16_t>(d) << 1) ^ static_cast<uint16_t>(d >> 15));
+      any |= zz[i];
+    }
+    int width = 0;
+    while (width < 16 && (any >> width) != 0) {
+      width++;
+    }
+
+    out[pos++] = static_cast<unsigned char>(width);
+    uint64_t acc = 0;
+    int nbits = 0;
+    for (int i = 0; i < kWaveformCodecBlock; i++) {
+      acc |= static_cast<uint64_t>(zz[i]) << nbits;
+      nbits += width;
+      while (nbits >= 8) {
+        out[pos++] = static_cast<unsigned char>(acc & 0xff);
+        acc >>= 8;
+        nbits -= 8;
+      }
+    }
+  }
+  return pos;
+}
+
+// Unpack the 16 zigzag values of one block (2*width bytes at in)
+inline void unpackWaveformBlock(const unsigned char *in, int width, uint16_t *zz) {
+  if (width == 0) {
+    std::memset(zz, 0, sizeof(uint16_t) * kWaveformCodecBlock);
+    return;
+  }
+  const uint32_t mask = (1u << width) - 1;
+  uint64_t acc = 0;
+  int nbits = 0;
+  for (int i = 0; i < kWaveformCodecBlock; i++) {
+    while (nbits < width) {
+      acc |= static_cast<uint64_t>(*in++) << nbits;
+      nbits += 8;
+    }
+    zz[i] = static_cast<uint16_t>(acc & mask);
+    acc >>= width;
+    nbits -= width;
+  }
+}
+
+// Decode nsample samples from nbytes at in; false if the data are truncated
+// or malformed
+inline bool decodeWaveform(const unsigned char *in, size_t nbytes, int nsample, short *wf) {
+  if (nsample <= 0) {
+    return true;
+  }
+  if (nbytes < 2) {
+    return false;
+  }
+  uint16_t prev = static_cast<uint16_t>(in[0] | (in[1] << 8));
+  wf[0] = static_cast<short>(prev);
+  size_t pos = 2;
+
+  alignas(16) uint16_t zz[kWaveformCodecBlock];
+  for (int b = 1; b < nsample; b += kWaveformCodecBlock) {
+    if (pos >= nbytes) {
+      return false;
+    }
+    const int width = in[pos++];
+    if (width > 16 || pos + 2 * width > nbytes) {
+      return false;
+    }
+    unpackWaveformBlock(in + pos, width, zz);
+    pos += 2 * width;
+
+    const int n = (nsample - b < kWaveformCodecBlock) ? nsample - b : kWaveformCodecBlock;
+#if defined(__SSE2__)
+    if (n == kWaveformCodecBlock) {
+      // zigzag decode and running sum, 8 lanes at a time
+      const __m128i one = _mm_set1_epi16(1);
+      const __m128i zero = _mm_setzero_si128();
+      for (int h = 0; h < kWaveformCodecBlock; h += 8) {
+        __m128i v = _mm_load_si128(reinterpret_cast<const __m128i *>(zz + h));
+        v = _mm_xor_si128(_mm_srli_epi16(v, 1), _mm_sub_epi16(zero, _mm_and_si128(v, one)));
+        v = _mm_add_epi16(v, _mm_slli_si128(v, 2));
+        v = _mm_add_epi16(v, _mm_slli_si128(v, 4));
+        v = _mm_add_epi16(v, _mm_slli_si128(v, 8));
+        v = _mm_add_epi16(v, _mm_set1_epi16(static_cast<short>(prev)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(wf + b + h), v);
+        prev = static_cast<uint16_t>(_mm_extract_epi16(v, 7));
+      }
+      continue;
+    }
+#endif
+    for (int i = 0; i < n; i++) {
+      const uint16_t d = static_cast<uint16_t>((zz[i] >> 1) ^ (0u - (zz[i] & 1u)));
+      prev = static_cast<uint16_t>(prev + d);
+      wf[b + i] = static_cast<short>(prev);
+    }
+  }
+  return true;
+}
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef WAVEFORM_KERNELS_H
+#define WAVEFORM_KERNELS_H
+
+#include <string>
+
+// Per-sample loops of analyzeWaveform, vectorized with AVX-512/AVX2 and
+// picked at runtime from what the CPU supports (scalar fallback). All
+// implementations give the same results as the scalar code.
+
+// Sum and sum of squares of wf[0..n), exact
+void waveformSampleSums(const short *wf, int n, long long &sum, long long &sumsq);
+
+// out[i] = (wf[i] - baseline) * sign for i in [0, n)
+void waveformSubtractBaseline(const short *wf, int n, double baseline, double sign, double *out);
+
+// Index of the first maximum of x[0..n), -1 if n <= 0
+int waveformArgMax(const double *x, int n);
+
+// Name of the selected implementation ("avx512", "avx2" or "scalar")
+const char *waveformKernelsImpl();
+
+// Force an implementation (benchmarks and cross checks); false if the build
+// or the CPU does not support it
+bool selectWaveformKernels(const std::string &name);
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef WFTREE_READER_H
+#define WFTREE_READER_H
+
+#include <string>
+#include <vector>
+
+#include <Rtypes.h>
+
+class TBranch;
+class TTree;
+
+// wftree layouts written by rfsoc_ridf_analyzer --schema
+enum class WftreeLayout { Channel, Event };
+
+struct WftreeChannel {
+  int det = 0;
+  int ch = 0;
+  int nsample = 0;
+  int crop_start = 0;        // first stored sample in the original trace (--suppress)
+  const short *wf = nullptr; // valid until the next read on the reader
+};
+
+// Reads wftree in either layout as (evtn, list of channels) per tree entry.
+// Channel layout: one channel per entry. Event layout: all channels of an
+// event in one entry, samples stored in one flat array with offsets.
+// Samples written with --pack-waveforms (wfpk column) are decoded on load.
+// Waveforms cropped by --suppress carry their crop_start (0 otherwise).
+class WftreeReader {
+public:
+  bool open(TTree *tree, std::string *error_message);
+
+  WftreeLayout layout() const { return layout_; }
+  bool packed() const { return packed_; }
+  bool cropped() const { return cropped_; }
+  Long64_t entries() const { return entries_; }
+  // Longest waveform the layout can hold (the plain channel layout reads into a fixed buffer)
+  int maxSamples() const;
+
+  // Read only evtn of an entry
+  int readEvtn(Long64_t entry);
+  // Read evtn and det/ch/nsample of an entry without the samples; returns the channel count
+  int readHeaders(Long64_t entry);
+  // Read an entry including the samples; returns the channel count
+  int load(Long64_t entry);
+
+  int evtn() const { return evtn_; }
+  int size() const { return static_cast<int>(channels_.size()); }
+  const WftreeChannel &channel(int i) const { return channels_[i]; }
+
+private:
+  void reserveChannels(int nch);
+  void reserveSamples(int nwf);
+  void reservePacked(int nbytes);
+  void decodePacked(Long64_t entry);
+  void updateChannels(bool with_samples);
+
+  WftreeLayout layout_ = WftreeLayout::Channel;
+  bool packed_ = false;
+  bool cropped_ = false;
+  TTree *tree_ = nullptr;
+  Long64_t entries_ = 0;
+  Long64_t loaded_entry_ = -1;
+
+  Int_t evtn_ = 0;
+  Int_t nch_ = 0;
+  Int_t nwf_ = 0;
+  std::vector<Int_t> det_;
+  std::vector<Int_t> ch_;
+  std::vector<Int_t> nsample_;
+  std::vector<Int_t> offset_;
+  std::vector<Int_t> crop_start_;
+  std::vector<Short_t> wf_;
+  Int_t nwfpk_ = 0;
+  std::vector<Int_t> pkoffset_;
+  std::vector<UChar_t> wfpk_;
+  std::vector<WftreeChannel> channels_;
+
+  TBranch *b_evtn_ = nullptr;
+  TBranch *b_nch_ = nullptr;
+  TBranch *b_det_ = nullptr;
+  TBranch *b_ch_ = nullptr;
+  TBranch *b_nsample_ = nullptr;
+  TBranch *b_offset_ = nullptr;
+  TBranch *b_crop_start_ = nullptr;
+  TBranch *b_nwf_ = nullptr;
+  TBranch *b_wf_ = nullptr;
+  TBranch *b_pkoffset_ = nullptr;
+  TBranch *b_nwfpk_ = nullptr;
+  TBranch *b_wfpk_ = nullptr;
+};
+
+#endif
@@ -69,6 +69,8 @@
 
 /* Size */
 #define RIDF_COMMENT_RUNINFO_ASC_SIZE   1024
+#define EB_EFBLOCK_SIZE     0x200000               /* Max size of block data = 4MB (in 16-bit words) */
+#define EB_EFBLOCK_BUFFSIZE (EB_EFBLOCK_SIZE * 2)  /* Receive buffer of one babinfo block (bytes) */
 
 /** RIDF readable header */
 struct ridf_rhdst{
@@ -0,0 +1,57 @@
+#include "AnalysisTree.h"
+
+#include <string>
+
+#include <TTree.h>
+
+void createAnalysisTree(AnalysisTreeOutput &out) {
+  static const char *kPercentNames[9] = {"10", "20", "30", "40", "50", "60", "70", "80", "90"};
+
+  out.tree = new TTree("analysis_tree", "Waveform analysis results");
+  out.filled_bytes = 0;
+  out.tree->Branch("evtn", &out.evtn, "evtn/I");
+  out.tree->Branch("det", &out.det, "det/I");
+  out.tree->Branch("ch", &out.ch, "ch/I");
+  out.tree->Branch("nsample", &out.nsample, "nsample/I");
+  out.tree->Branch("baseline", &out.baseline, "baseline/F");
+  out.tree->Branch("baseline_rms", &out.baseline_rms, "baseline_rms/F");
+  out.tree->Branch("amplitude", &out.amplitude, "amplitude/F");
+  out.tree->Branch("peak_sample", &out.peak_sample, "peak_sample/I");
+  out.tree->Branch("peak_time_ns", &out.peak_time_ns, "peak_time_ns/F");
+  out.tree->Branch("cfd_time_ns", &out.cfd_time_ns, "cfd_time_ns/F");
+  for (int i = 0; i < 9; i++) {
+    const std::string name = std::string("cfd") + kPercentNames[i];
+    out.tree->Branch(name.c_str(), &out.cfd[i], (name + "/F").c_str());
+  }
+  out.tree->Branch("dcfd_time_ns", &out.dcfd_time_ns, "dcfd_time_ns/F");
+  for (int i = 0; i < 9; i++) {
+    const std::string name = std::string("dcfd") + kPercentNames[i];
+    out.tree->Branch(name.c_str(), &out.dcfd[i], (name + "/F").c_str());
+  }
+  out.tree->Branch("risetime", &out.risetime, "risetime/F");
+  out.tree->Branch("valid", &out.valid, "valid/O");
+}
+
+void fillAnalysisTree(AnalysisTreeOutput &out, int evtn, int det, int ch, int nsample,
+                      const WaveformAnalysisResult &result) {
+  out.evtn = evtn;
+  out.det = det;
+  out.ch = ch;
+  out.nsample = nsample;
+  out.baseline = result.baseline;
+  out.baseline_rms = result.baseline_rms;
+  out.amplitude = result.amplitude;
+  out.peak_sample = result.peak_sample;
+  out.peak_time_ns = result.peak_time_ns;
+  out.cfd_time_ns = result.cfd_time_ns;
+  for (int i = 0; i < 9; i++) {
+    out.cfd[i] = result.cfd_times[i];
+  }
+  out.dcfd_time_ns = result.dcfd_time_ns;
+  for (int i = 0; i < 9; i++) {
+    out.dcfd[i] = result.dcfd_times[i];
+  }
+  out.risetime = result.risetime;
+  out.valid = result.valid;
+  out.filled_bytes += out.tree->Fill();
+}
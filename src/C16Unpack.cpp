@@ -0,0 +1,214 @@
+#include "C16Unpack.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define C16_X86 1
+#endif
+
+namespace {
+
+void count_hist(const short *wf, int n, unsigned int *hist){
+  int i;
+  if(!hist){
+    return;
+  }
+  for(i=0;i<n;i++){
+    hist[(wf[i] + 2048) & 0xfff]++;
+  }
+}
+
+void unpack_scalar(const unsigned short *raw, int n, short *wf,
+		   unsigned int *hist, struct c16_stats *st){
+  short mn = 32767, mx = -32768, v;
+  long long sum = 0, sumsq = 0;
+  int i;
+
+  for(i=0;i<n;i++){
+    v = (short)((short)raw[i] >> 4);
+    wf[i] = v;
+    if(v < mn) mn = v;
+    if(v > mx) mx = v;
+    sum += v;
+    sumsq += v * v;
+  }
+  count_hist(wf, n, hist);
+
+  st->min = mn;
+  st->max = mx;
+  st->sum = sum;
+  st->sumsq = sumsq;
+}
+
+#if defined(C16_X86) && defined(__SSE2__)
+void unpack_sse2(const unsigned short *raw, int n, short *wf,
+		 unsigned int *hist, struct c16_stats *st){
+  const __m128i ones = _mm_set1_epi16(1);
+  const __m128i zero = _mm_setzero_si128();
+  __m128i vmin = _mm_set1_epi16(32767);
+  __m128i vmax = _mm_set1_epi16(-32768);
+  __m128i vsum = _mm_setzero_si128();    // 4 x int32, |sum| < 2^31 for n < 2^21
+  __m128i vsq = _mm_setzero_si128();     // 2 x int64
+  short tmin[8], tmax[8];
+  int tsum[4];
+  long long tsq[2];
+  struct c16_stats tail;
+  int i = 0, k;
+
+  for(;i+8<=n;i+=8){
+    __m128i v = _mm_srai_epi16(_mm_loadu_si128((const __m128i *)(raw + i)), 4);
+    _mm_storeu_si128((__m128i *)(wf + i), v);
+    vmin = _mm_min_epi16(vmin, v);
+    vmax = _mm_max_epi16(vmax, v);
+    vsum = _mm_add_epi32(vsum, _mm_madd_epi16(v, ones));
+    // pairs of squares fit in int32 (<= 2 * 2048^2), widen before accumulating
+    __m128i sq = _mm_madd_epi16(v, v);
+    vsq = _mm_add_epi64(vsq, _mm_unpacklo_epi32(sq, zero));
+    vsq = _mm_add_epi64(vsq, _mm_unpackhi_epi32(sq, zero));
+  }
+
+  _mm_storeu_si128((__m128i *)tmin, vmin);
+  _mm_storeu_si128((__m128i *)tmax, vmax);
+  _mm_storeu_si128((__m128i *)tsum, vsum);
+  _mm_storeu_si128((__m128i *)tsq, vsq);
+
+  unpack_scalar(raw + i, n - i, wf + i, NULL, &tail);
+  for(k=0;k<8;k++){
+    if(tmin[k] < tail.min) tail.min = tmin[k];
+    if(tmax[k] > tail.max) tail.max = tmax[k];
+  }
+  for(k=0;k<4;k++){
+    tail.sum += tsum[k];
+  }
+  tail.sumsq += tsq[0] + tsq[1];
+  count_hist(wf, n, hist);
+
+  *st = tail;
+}
+#endif
+
+#if defined(C16_X86) && (defined(__GNUC__) || defined(__clang__))
+#define C16_HAVE_AVX2 1
+__attribute__((target("avx2")))
+void unpack_avx2(const unsigned short *raw, int n, short *wf,
+		 unsigned int *hist, struct c16_stats *st){
+  const __m256i ones = _mm256_set1_epi16(1);
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i vmin = _mm256_set1_epi16(32767);
+  __m256i vmax = _mm256_set1_epi16(-32768);
+  __m256i vsum = _mm256_setzero_si256();
+  __m256i vsq = _mm256_setzero_si256();
+  short tmin[16], tmax[16];
+  int tsum[8];
+  long long tsq[4];
+  struct c16_stats tail;
+  int i = 0, k;
+
+  for(;i+16<=n;i+=16){
+    __m256i v = _mm256_srai_epi16(_mm256_loadu_si256((const __m256i *)(raw + i)), 4);
+    _mm256_storeu_si256((__m256i *)(wf + i), v);
+    vmin = _mm256_min_epi16(vmin, v);
+    vmax = _mm256_max_epi16(vmax, v);
+    vsum = _mm256_add_epi32(vsum, _mm256_madd_epi16(v, ones));
+    __m256i sq = _mm256_madd_epi16(v, v);
+    vsq = _mm256_add_epi64(vsq, _mm256_unpacklo_epi32(sq, zero));
+    vsq = _mm256_add_epi64(vsq, _mm256_unpackhi_epi32(sq, zero));
+  }
+
+  _mm256_storeu_si256((__m256i *)tmin, vmin);
+  _mm256_storeu_si256((__m256i *)tmax, vmax);
+  _mm256_storeu_si256((__m256i *)tsum, vsum);
+  _mm256_storeu_si256((__m256i *)tsq, vsq);
+
+  unpack_scalar(raw + i, n - i, wf + i, NULL, &tail);
+  for(k=0;k<16;k++){
+    if(tmin[k] < tail.min) tail.min = tmin[k];
+    if(tmax[k] > tail.max) tail.max = tmax[k];
+  }
+  for(k=0;k<8;k++){
+    tail.sum += tsum[k];
+  }
+  for(k=0;k<4;k++){
+    tail.sumsq += tsq[k];
+  }
+  count_hist(wf, n, hist);
+
+  *st = tail;
+}
+#endif
+
+typedef void (*unpack_func)(const unsigned short *, int, short *, unsigned int *, struct c16_stats *);
+
+struct unpack_impl{
+  unpack_func func;
+  const char *name;
+};
+
+unpack_impl select_default(void){
+#ifdef C16_HAVE_AVX2
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2")){
+    return {unpack_avx2, "avx2"};
+  }
+#endif
+#if defined(C16_X86) && defined(__SSE2__)
+  return {unpack_sse2, "sse2"};
+#else
+  return {unpack_scalar, "scalar"};
+#endif
+}
+
+unpack_impl &current(void){
+  static unpack_impl impl = select_default();
+  return impl;
+}
+
+} // namespace
+
+void c16_unpack_stats(const unsigned short *raw, int n, short *wf,
+		      unsigned int *hist, struct c16_stats *st){
+  current().func(raw, n, wf, hist, st);
+}
+
+void c16_sample_stats(const short *wf, int n, unsigned int *hist, struct c16_stats *st){
+  short mn = 32767, mx = -32768;
+  long long sum = 0, sumsq = 0;
+  int i;
+
+  for(i=0;i<n;i++){
+    if(wf[i] < mn) mn = wf[i];
+    if(wf[i] > mx) mx = wf[i];
+    sum += wf[i];
+    sumsq += wf[i] * wf[i];
+  }
+  count_hist(wf, n, hist);
+
+  st->min = mn;
+  st->max = mx;
+  st->sum = sum;
+  st->sumsq = sumsq;
+}
+
+const char *c16_unpack_impl(void){
+  return current().name;
+}
+
+int c16_unpack_select(const char *name){
+  if(strcmp(name, "scalar") == 0){
+    current() = {unpack_scalar, "scalar"};
+    return 0;
+  }
+#if defined(C16_X86) && defined(__SSE2__)
+  if(strcmp(name, "sse2") == 0){
+    current() = {unpack_sse2, "sse2"};
+    return 0;
+  }
+#endif
+#ifdef C16_HAVE_AVX2
+  if(strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")){
+    current() = {unpack_avx2, "avx2"};
+    return 0;
+  }
+#endif
+  return -1;
+}
@@ -14,6 +14,18 @@ int ModuleAbst::decode(char *ptr, int sz, int data[4]){
   return 1;
 }
 
+void ModuleAbst::reset(){
+  idx = 0;
+  geo = -1;
+  ch = 0;
+  edge = 0;
+}
+
+const unsigned short *ModuleAbst::samples(char *ptr, int sz, int *n){
+  *n = 0;
+  return NULL;
+}
+
 void ModuleAbst::test(){
   printf("test func decode abst\n");
 }
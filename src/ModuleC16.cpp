@@ -30,6 +30,15 @@ int ModuleC16::decode(char *ptr, int sz, int data[4]){
   return 0;
 }
 
+void ModuleC16::reset(){
+  ModuleAbst::reset();
+  evtflag = 0;
+}
+
+const unsigned short *ModuleC16::samples(char *ptr, int sz, int *n){
+  *n = sz/sizeof(unsigned short);
+  return (const unsigned short *)ptr;
+}
 
 void ModuleC16::test(){
   printf("test func decode C16\n");
@@ -1,11 +1,19 @@
 #include "RIDFParser.h"
 #include "ridf.h"
 #include "ModuleC16.h"
+#include "RIDFPrefetch.h"
+#include "RIDFPullMux.h"
 #include <TObject.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <string>
+#include <vector>
 
 ClassImp(RIDFParser);
 
@@ -13,17 +21,20 @@ RIDFParser::RIDFParser(){
   if(!seglist){
     seglist = (int *)malloc(4*256);
   }
+
+  // built-in module decoders
+  setdecoder(0, new ModuleC16());
 };
 
 RIDFParser::~RIDFParser(){
+  stopprefetch();
+  freeindex();
   if(gfd){
     fclose(gfd);
     gfd = NULL;
   }
-  if(puller){
-    delete puller;
-    puller = NULL;
-  }
+  unmapfile();
+  closeonline();
   if(gbuff){
     free(gbuff);
     gbuff = NULL;
@@ -32,25 +43,28 @@ RIDFParser::~RIDFParser(){
     free(seglist);
     seglist = NULL;
   }
-  if(decoder){
-    delete decoder;
-    decoder = NULL;
+  for(int i=0;i<256;i++){
+    if(decoders[i]){
+      delete decoders[i];
+      decoders[i] = NULL;
+    }
   }
+  decoder = NULL;
 }
 
 void RIDFParser::test(){
 }
 
 int RIDFParser::file(const char *file){
+  stopprefetch();
+  freeindex();
   if(gfd){
     fclose(gfd);
     gfd = NULL;
   }
+  unmapfile();
 
-  if(puller){
-    delete puller;
-    puller = NULL;
-  }
+  closeonline();
 
   if(!gbuff){
     gbuff = (char *)malloc(1024*1024);
@@ -63,6 +77,9 @@ int RIDFParser::file(const char *file){
   gsidx = 0;
   gnsidx = 0;
   gevtn = 0;
+  gblkn = -1;
+  gblksz = 0;
+  gblkcnt = 0;
   gssz = 0;
 
   if(gfd == NULL){
@@ -74,20 +91,407 @@ int RIDFParser::file(const char *file){
   return 1;
 };
 
-int RIDFParser::online(const char *host){
+int RIDFParser::mapfile(const char *file){
+  int fd;
+  struct stat st;
+  void *map;
+
+  stopprefetch();
+  freeindex();
   if(gfd){
     fclose(gfd);
     gfd = NULL;
   }
+  unmapfile();
 
-  if(puller){
-    delete puller;
-    puller = NULL;
+  closeonline();
+
+  gidx = 0;
+  gsz = 0;
+  gnidx = 0;
+  gsidx = 0;
+  gnsidx = 0;
+  gevtn = 0;
+  gblkn = -1;
+  gblksz = 0;
+  gblkcnt = 0;
+  gssz = 0;
+
+  if((fd = open(file, O_RDONLY)) < 0){
+    return -1;
+  }
+  if(fstat(fd, &st) < 0 || st.st_size < 8){
+    ::close(fd);
+    return -1;
   }
 
-  if(!gbuff){
-    gbuff = (char *)malloc(1024*1024);
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping stays valid after closing the descriptor
+  ::close(fd);
+  if(map == MAP_FAILED){
+    return -1;
+  }
+  madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+  gmap = (char *)map;
+  gmapsz = st.st_size;
+  gmapoff = 0;
+
+  snprintf(fpath, sizeof(fpath), "%s", file);
+
+  return 1;
+}
+
+int RIDFParser::unmapfile(void){
+  if(gmap){
+    munmap(gmap, gmapsz);
+    gmap = NULL;
+    gmapsz = 0;
+    gmapoff = 0;
+    gblk = NULL;
+    return 1;
+  }
+  return 0;
+}
+
+int RIDFParser::prefetch(int nbuf){
+  stopprefetch();
+
+  if(nbuf <= 0 || !gfd){
+    return 0;
+  }
+
+  prefetcher = new RIDFPrefetch([this](char *buff){ return getblockdata(gfd, buff); },
+				nbuf, 1024*1024);
+  prefetcher->start();
+
+  return 1;
+}
+
+int RIDFParser::stopprefetch(void){
+  if(prefetcher){
+    delete prefetcher;
+    prefetcher = NULL;
+    gblk = NULL;
+    return 1;
+  }
+  return 0;
+}
+
+int RIDFParser::readblockat(long long off, char *buff, char **blk){
+  int sz = 0;
+
+  if(gmap){
+    if(off + 8 > gmapsz){
+      return -1;
+    }
+    memcpy((char *)&sz, gmap+off, 4);
+    sz = (sz & 0x003fffff) * 2;
+    if(sz < 8 || off + sz > gmapsz){
+      return -1;
+    }
+    *blk = gmap + off;
+    return sz;
+  }
+
+  if(!gfd){
+    return -1;
+  }
+  // pread does not move the stream position used by nextevt()
+  if(pread(fileno(gfd), buff, 8, off) != 8){
+    return -1;
+  }
+  memcpy((char *)&sz, buff, 4);
+  sz = (sz & 0x003fffff) * 2;
+  if(sz < 8 || sz > 1024*1024){
+    return -1;
+  }
+  if(sz > 8 && pread(fileno(gfd), buff+8, sz-8, off+8) != sz-8){
+    return -1;
+  }
+  *blk = buff;
+
+  return sz;
+}
+
+long long *RIDFParser::scanblocks(int *nblk){
+  long long off = 0, fsz;
+  long long *offs = NULL;
+  int n = 0, cap = 0, sz = 0;
+  char hd[8];
+
+  *nblk = 0;
+  if(gmap){
+    fsz = gmapsz;
+  }else if(gfd){
+    struct stat st;
+    if(fstat(fileno(gfd), &st) < 0){
+      return NULL;
+    }
+    fsz = st.st_size;
+  }else{
+    return NULL;
+  }
+
+  while(off + 8 <= fsz){
+    if(gmap){
+      memcpy((char *)&sz, gmap+off, 4);
+    }else{
+      if(pread(fileno(gfd), hd, 8, off) != 8){
+	break;
+      }
+      memcpy((char *)&sz, hd, 4);
+    }
+    sz = (sz & 0x003fffff) * 2;
+    if(sz < 8 || off + sz > fsz){
+      break;
+    }
+    if(n == cap){
+      cap = cap ? cap * 2 : 1024;
+      offs = (long long *)realloc(offs, sizeof(long long) * cap);
+    }
+    offs[n++] = off;
+    off += sz;
+  }
+
+  if(!offs){
+    offs = (long long *)malloc(sizeof(long long));
+  }
+  *nblk = n;
+  return offs;
+}
+
+int RIDFParser::buildindex(void){
+  long long off = 0;
+  int sz, n, nidx, sidx, evtn, cap = 0;
+  unsigned long long int ts;
+  char *buff = NULL, *blk;
+
+  if(!gfd && !gmap){
+    return -1;
+  }
+
+  freeindex();
+  if(gfd){
+    buff = (char *)malloc(1024*1024);
+  }
+
+  gindexsorted = 1;
+  while((sz = readblockat(off, buff, &blk)) > 0){
+    n = 8;
+    while((n = getevtindex(blk, n, sz, &nidx, &sidx, &evtn, &ts)) >= 0){
+      if(gnindex == cap){
+	cap = cap ? cap * 2 : 4096;
+	gindex = (struct ridx_entry *)realloc(gindex, sizeof(struct ridx_entry) * cap);
+      }
+      gindex[gnindex].blkoff = off;
+      gindex[gnindex].idx = n;
+      gindex[gnindex].evtn = evtn;
+      gindex[gnindex].ts = ts;
+      if(gnindex > 0 && gindex[gnindex-1].evtn > gindex[gnindex].evtn){
+	gindexsorted = 0;
+      }
+      gnindex++;
+      if(nidx >= sz - 4){
+	break;
+      }
+      n = nidx;
+    }
+    off += sz;
+  }
+
+  if(buff){
+    free(buff);
+  }
+
+  return gnindex;
+}
+
+// .ridx layout: "RIDX", version, size and mtime of the RIDF file,
+// number of entries, then packed ridx_entry
+int RIDFParser::saveindex(const char *path){
+  FILE *fd;
+  struct stat st;
+  int ver = 1;
+  long long fsz, mtime, n;
+
+  if(!gindex || stat(fpath, &st) < 0){
+    return -1;
+  }
+  if((fd = fopen(path, "w")) == NULL){
+    return -1;
+  }
+
+  fsz = st.st_size;
+  mtime = st.st_mtime;
+  n = gnindex;
+  fwrite("RIDX", 4, 1, fd);
+  fwrite((char *)&ver, sizeof(ver), 1, fd);
+  fwrite((char *)&fsz, sizeof(fsz), 1, fd);
+  fwrite((char *)&mtime, sizeof(mtime), 1, fd);
+  fwrite((char *)&n, sizeof(n), 1, fd);
+  if(fwrite((char *)gindex, sizeof(struct ridx_entry), gnindex, fd) != (size_t)gnindex){
+    fclose(fd);
+    return -1;
+  }
+  fclose(fd);
+
+  return gnindex;
+}
+
+int RIDFParser::loadindex(const char *path){
+  FILE *fd;
+  struct stat st;
+  char magic[4];
+  int ver = 0, i;
+  long long fsz = 0, mtime = 0, n = 0;
+
+  if((!gfd && !gmap) || stat(fpath, &st) < 0){
+    return -1;
+  }
+  if((fd = fopen(path, "r")) == NULL){
+    return -1;
+  }
+
+  if(fread(magic, 4, 1, fd) != 1 || memcmp(magic, "RIDX", 4) != 0
+     || fread((char *)&ver, sizeof(ver), 1, fd) != 1 || ver != 1
+     || fread((char *)&fsz, sizeof(fsz), 1, fd) != 1
+     || fread((char *)&mtime, sizeof(mtime), 1, fd) != 1
+     || fread((char *)&n, sizeof(n), 1, fd) != 1){
+    fclose(fd);
+    return -1;
+  }
+
+  // stale index : RIDF file was rewritten or is still growing
+  if(fsz != (long long)st.st_size || mtime != (long long)st.st_mtime || n < 0){
+    fclose(fd);
+    return -1;
+  }
+
+  freeindex();
+  gindex = (struct ridx_entry *)malloc(sizeof(struct ridx_entry) * (n > 0 ? n : 1));
+  if(fread((char *)gindex, sizeof(struct ridx_entry), n, fd) != (size_t)n){
+    fclose(fd);
+    freeindex();
+    return -1;
+  }
+  fclose(fd);
+
+  gnindex = n;
+  gindexsorted = 1;
+  for(i=1;i<gnindex;i++){
+    if(gindex[i-1].evtn > gindex[i].evtn){
+      gindexsorted = 0;
+      break;
+    }
+  }
+
+  return gnindex;
+}
+
+int RIDFParser::useindex(void){
+  char ipath[sizeof(fpath)+8];
+  int n;
+
+  if(!gfd && !gmap){
+    return -1;
+  }
+
+  snprintf(ipath, sizeof(ipath), "%s.ridx", fpath);
+  if((n = loadindex(ipath)) >= 0){
+    return n;
+  }
+
+  if((n = buildindex()) < 0){
+    return -1;
+  }
+  if(saveindex(ipath) < 0){
+    printf("Warning: cannot write event index %s\n", ipath);
+  }
+
+  return n;
+}
+
+int RIDFParser::freeindex(void){
+  if(gindex){
+    free(gindex);
+    gindex = NULL;
+    gnindex = 0;
+    gindexsorted = 0;
+    return 1;
+  }
+  return 0;
+}
+
+int RIDFParser::seekevt(int evtn){
+  struct ridx_entry *e = NULL;
+  unsigned int uevtn = evtn;
+  int i, sz;
+
+  if(!gindex || (!gfd && !gmap)){
+    return -1;
+  }
+
+  if(gindexsorted){
+    e = std::lower_bound(gindex, gindex + gnindex, uevtn,
+			 [](const struct ridx_entry &a, unsigned int v){ return a.evtn < v; });
+    if(e == gindex + gnindex){
+      e = NULL;
+    }
+  }else{
+    for(i=0;i<gnindex;i++){
+      if(gindex[i].evtn >= uevtn){
+	e = gindex + i;
+	break;
+      }
+    }
+  }
+  if(!e){
+    return -1;
+  }
+
+  if(prefetcher){
+    prefetcher->stop();
+  }
+  if(gmap){
+    gmapoff = e->blkoff;
+  }else{
+    fseeko(gfd, e->blkoff, SEEK_SET);
+  }
+  if(prefetcher){
+    prefetcher->start();
+  }
+
+  sz = getgblock();
+  if(sz <= 0){
+    gidx = 0;
+    gsz = 0;
+    return -1;
+  }
+
+  gsz = sz;
+  gidx = e->idx;
+  gnidx = 0;
+  gsidx = 0;
+  gnsidx = 0;
+
+  return 0;
+}
+
+int RIDFParser::online(const char *host){
+  stopprefetch();
+  freeindex();
+  if(gfd){
+    fclose(gfd);
+    gfd = NULL;
   }
+  unmapfile();
+
+  closeonline();
+
+  // online blocks can be larger than the file-mode buffer
+  free(gbuff);
+  gbuff = (char *)malloc(EB_EFBLOCK_BUFFSIZE);
 
   gidx = 0;
   gsz = 0;
@@ -95,19 +499,107 @@ int RIDFParser::online(const char *host){
   gsidx = 0;
   gnsidx = 0;
   gevtn = 0;
+  gblkn = -1;
+  gblksz = 0;
+  gblkcnt = 0;
   gssz = 0;
 
   snprintf(fpath, sizeof(fpath), "%s", host);
+  gsrc = 0;
 
-  puller = new RIDFPull(host);
-  
-  return 1;
+  if(!strchr(host, ',')){
+    puller = new RIDFPull(host);
+    return 1;
+  }
+
+  // several hosts: one receiver thread per host
+  std::vector<std::string> hosts;
+  std::string list(host);
+  size_t pos = 0, end;
+  while(pos <= list.size()){
+    end = list.find(',', pos);
+    if(end == std::string::npos){
+      end = list.size();
+    }
+    if(end > pos){
+      hosts.push_back(list.substr(pos, end - pos));
+    }
+    pos = end + 1;
+  }
+
+  pullmux = new RIDFPullMux((int)hosts.size() * 4, EB_EFBLOCK_BUFFSIZE);
+  for(const std::string &h : hosts){
+    pullmux->addhost(h.c_str());
+  }
+  pullmux->start();
+
+  return (int)hosts.size();
 };
 
+int RIDFParser::closeonline(void){
+  int ret = 0;
+  gsrc = 0;
+  if(puller){
+    delete puller;
+    puller = NULL;
+    ret = 1;
+  }
+  if(pullmux){
+    delete pullmux;
+    pullmux = NULL;
+    ret = 1;
+  }
+  return ret;
+}
+
+int RIDFParser::nsource(void){
+  if(pullmux){
+    return pullmux->nhost();
+  }
+  return puller ? 1 : 0;
+}
+
+const char *RIDFParser::sourcename(int src){
+  if(pullmux){
+    return pullmux->hostname(src);
+  }
+  if(puller && src == 0){
+    return puller->hostname();
+  }
+  return NULL;
+}
+
+int RIDFParser::sourcestats(int src, struct ridfpull_stats *st){
+  if(pullmux){
+    return pullmux->getstats(src, st);
+  }
+  if(puller && src == 0){
+    puller->getstats(st);
+    return 0;
+  }
+  return -1;
+}
+
 
 int RIDFParser::rewindfile(void){
   if(gfd){
+    if(prefetcher){
+      prefetcher->stop();
+    }
     rewind(gfd);
+    if(prefetcher){
+      prefetcher->start();
+    }
+    gidx = 0;
+    gsz = 0;
+    gnidx = 0;
+    gsidx = 0;
+    gnsidx = 0;
+    gevtn = 0;
+    return 1;
+  }
+  if(gmap){
+    gmapoff = 0;
     gidx = 0;
     gsz = 0;
     gnidx = 0;
@@ -122,14 +614,17 @@ int RIDFParser::rewindfile(void){
 
 int RIDFParser::close(void){
   int ret = 0;
+  stopprefetch();
+  freeindex();
   if(gfd){
     fclose(gfd);
     gfd = NULL;
     ret = 1;
   }
-  if(puller){
-    delete puller;
-    puller = NULL;
+  if(unmapfile()){
+    ret = 1;
+  }
+  if(closeonline()){
     ret = 1;
   }
   return ret;
@@ -137,7 +632,7 @@ int RIDFParser::close(void){
 
 char *RIDFParser::status(void){
   
-  if(!gfd){
+  if(!gfd && !gmap){
     snprintf(gline, sizeof(gline), "ridf is not opened");
   }else{
     snprintf(gline, sizeof(gline), "ridf %s", fpath);
@@ -200,7 +695,7 @@ void RIDFParser::showsegid(void){
 // -3: not file open
 char *RIDFParser::nextevtdata(int *evtn, int *idx, int *sz, int *flag){
 
-  if(!gfd && !puller){
+  if(!gfd && !puller && !pullmux && !gmap){
     *flag = -3;
     return NULL;
   }
@@ -228,7 +723,7 @@ char *RIDFParser::nextevtdata(int *evtn, int *idx, int *sz, int *flag){
   *sz = gsz;  
 
   // find evtdata
-  gidx = getevtindex(gbuff, gidx, gsz, &gnidx, &gsidx, evtn, &gts);
+  gidx = getevtindex(gblk, gidx, gsz, &gnidx, &gsidx, evtn, &gts);
   gnsidx = gsidx;
   if(gidx < 0){
     gidx = 0;
@@ -243,15 +738,72 @@ char *RIDFParser::nextevtdata(int *evtn, int *idx, int *sz, int *flag){
     *idx = 0;
     *flag = 0;
   }
-  return gbuff;
+  return gblk;
+}
+
+int RIDFParser::nextblock(char **blk){
+  int sz;
+
+  if(!gfd && !puller && !pullmux && !gmap){
+    return -1;
+  }
+
+  sz = getgblock();
+  gidx = 0;
+  gsz = 0;
+  gnidx = 0;
+  gsidx = 0;
+  gnsidx = 0;
+  if(sz < 0){
+    return -1;
+  }
+  *blk = gblk;
+
+  return sz;
 }
 
 int RIDFParser::getgblock(){
+  int sz = readgblock();
+
+  if(sz > 0){
+    gblkn = getblkn(gblk, sz);
+    gblksz = sz;
+    gblkcnt++;
+  }
+  return sz;
+}
+
+int RIDFParser::getblkn(char *buff, int sz){
+  int thd, blkn;
+
+  if(sz < 20){
+    return -1;
+  }
+  memcpy((char *)&thd, buff+8, sizeof(thd));
+  if(RIDF_CI(thd) != 8){
+    return -1;
+  }
+  memcpy((char *)&blkn, buff+16, sizeof(blkn));
+
+  return blkn;
+}
+
+int RIDFParser::readgblock(){
+  if(gmap){
+    return getmapblock(&gblk);
+  }
+  if(prefetcher){
+    return prefetcher->next(&gblk);
+  }
+  if(pullmux){
+    return pullmux->next(&gblk, &gsrc);
+  }
+  gblk = gbuff;
   if(gfd){
     return getblockdata(gfd, gbuff);
   }
   if(puller){
-    return puller->pull(gbuff);
+    return puller->pull(gbuff, EB_EFBLOCK_BUFFSIZE);
   }
 
   return -1;
@@ -260,14 +812,37 @@ int RIDFParser::getgblock(){
 int RIDFParser::getblockdata(FILE *fd, char *buff){
   int sz = 0;
 
-  if(!feof(fd)){
-    fread(buff, 8, 1, fd);
-    memcpy((char *)&sz, buff, 4);
-    sz = (sz & 0x003fffff) * 2;
-    fread(buff+8, sz-8, 1, fd);
-  }else{
+  // feof() is only set after a short read, so check fread itself
+  // (otherwise the last block is returned twice)
+  if(fread(buff, 8, 1, fd) != 1){
+    return -1;
+  }
+  memcpy((char *)&sz, buff, 4);
+  sz = (sz & 0x003fffff) * 2;
+  if(sz < 8 || sz > 1024*1024){
+    return -1;
+  }
+  if(sz > 8 && fread(buff+8, sz-8, 1, fd) != 1){
+    return -1;
+  }
+
+  return sz;
+}
+
+int RIDFParser::getmapblock(char **blk){
+  int sz = 0;
+
+  if(gmapoff + 8 > gmapsz){
     return -1;
   }
+  memcpy((char *)&sz, gmap+gmapoff, 4);
+  sz = (sz & 0x003fffff) * 2;
+  if(sz < 8 || gmapoff + sz > gmapsz){
+    return -1;
+  }
+
+  *blk = gmap + gmapoff;
+  gmapoff += sz;
 
   return sz;
 }
@@ -349,24 +924,41 @@ int RIDFParser::nextevt(int *evtn){
   return tflag;
 }
 
+int RIDFParser::setdecoder(int mod, ModuleAbst *dec){
+  if(mod < 0 || mod > 0xff){
+    return -1;
+  }
+
+  if(decoders[mod] && decoders[mod] != dec){
+    if(decoder == decoders[mod]){
+      decoder = NULL;
+    }
+    delete decoders[mod];
+  }
+  decoders[mod] = dec;
+
+  return 0;
+}
+
+ModuleAbst *RIDFParser::getdecoder(int mod){
+  if(mod < 0 || mod > 0xff){
+    return NULL;
+  }
+  return decoders[mod];
+}
+
 //0 = normal, -1 = end of segment data
 int RIDFParser::nextseg(int *segid){
   int mod;
 
   gsidx = gnsidx;
-  gsidx = getsegindex(gbuff, gsidx, gsz, &gnsidx, segid);
+  gsidx = getsegindex(gblk, gsidx, gsz, &gnsidx, segid);
   gssz = gnsidx - gsidx - 12;
   mod = *segid & 0xff;
 
-  if(decoder) delete decoder;
-  
-  switch(mod){
-  case 0:
-    decoder = new ModuleC16();
-    break;
-  default:
-    decoder = NULL;
-    break;
+  decoder = decoders[mod];
+  if(decoder){
+    decoder->reset();
   }
 
   if(gsidx < 0){
@@ -376,6 +968,16 @@ int RIDFParser::nextseg(int *segid){
   }
 }
 
+const unsigned short *RIDFParser::segdata(int *n){
+  *n = 0;
+
+  if(gsidx < 0 || gnsidx <= gsidx + 12 || decoder == NULL){
+    return NULL;
+  }
+
+  return decoder->samples(gblk+gsidx+12, gssz, n);
+}
+
 //data[4] : geo, ch, edge, value
 //return  : 0=normal, 1=no decorder (return 32bit value), -1=end of segment
 int RIDFParser::nextdata(int segid, int data[4]){
@@ -390,11 +992,11 @@ int RIDFParser::nextdata(int segid, int data[4]){
   }
 
   if(decoder == NULL){
-    memcpy((char *)&ival, gbuff+gsidx+12, 4);
+    memcpy((char *)&ival, gblk+gsidx+12, 4);
     data[3] = ival;
     gsidx += 4;
   }else{
-    ret = decoder->decode(gbuff+gsidx+12, gssz, data);
+    ret = decoder->decode(gblk+gsidx+12, gssz, data);
   }
 
   return ret;
@@ -0,0 +1,118 @@
+#include "RIDFPrefetch.h"
+#include <stdlib.h>
+
+RIDFPrefetch::RIDFPrefetch(std::function<int(char *)> reader, int n, int sz)
+  : rfunc(reader), nbuf(n < 2 ? 2 : n), bufsz(sz){
+  int i;
+
+  bufs = (char **)malloc(sizeof(char *) * nbuf);
+  sizes = (int *)malloc(sizeof(int) * nbuf);
+  for(i=0;i<nbuf;i++){
+    bufs[i] = (char *)malloc(bufsz);
+    sizes[i] = 0;
+  }
+}
+
+RIDFPrefetch::~RIDFPrefetch(){
+  int i;
+
+  stop();
+  for(i=0;i<nbuf;i++){
+    free(bufs[i]);
+  }
+  free(bufs);
+  free(sizes);
+}
+
+int RIDFPrefetch::start(void){
+  if(th){
+    return 0;
+  }
+
+  head = 0;
+  count = 0;
+  held = 0;
+  eof = 0;
+  quit = 0;
+  th = new std::thread(&RIDFPrefetch::run, this);
+
+  return 1;
+}
+
+int RIDFPrefetch::stop(void){
+  if(!th){
+    return 0;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    quit = 1;
+  }
+  cv.notify_all();
+  th->join();
+  delete th;
+  th = NULL;
+
+  return 1;
+}
+
+void RIDFPrefetch::run(void){
+  int tail, sz;
+
+  while(1){
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      cv.wait(lock, [this]{ return quit || count + held < nbuf; });
+      if(quit){
+	return;
+      }
+      tail = (head + count + held) % nbuf;
+    }
+
+    // read without holding the lock, the slot is not visible to next() yet
+    sz = rfunc(bufs[tail]);
+
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      if(sz <= 0){
+	eof = 1;
+      }else{
+	sizes[tail] = sz;
+	count++;
+      }
+    }
+    cv.notify_all();
+
+    if(sz <= 0){
+      return;
+    }
+  }
+}
+
+int RIDFPrefetch::next(char **blk){
+  int cur;
+  std::unique_lock<std::mutex> lock(mtx);
+
+  if(held){
+    head = (head + 1) % nbuf;
+    held = 0;
+    cv.notify_all();
+  }
+
+  cv.wait(lock, [this]{ return count > 0 || eof || quit; });
+  if(count == 0){
+    return -1;
+  }
+
+  cur = head;
+  count--;
+  held = 1;
+  *blk = bufs[cur];
+
+  return sizes[cur];
+}
+
+int RIDFPrefetch::depth(void){
+  std::lock_guard<std::mutex> lock(mtx);
+  return count;
+}
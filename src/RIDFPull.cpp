@@ -13,6 +13,7 @@
 #include <sys/time.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <poll.h>
 
 #include <iostream>
 
@@ -20,8 +21,6 @@
 #include "ridf.h"
 
 #define INFCOMPORT  17516   ///< babinfo communication port
-#define EB_EFBLOCK_SIZE 0x200000   ///< Usual max size of block data = 4MB (w
-#define EB_EFBLOCK_BUFFSIZE EB_EFBLOCK_SIZE * 2  ///< Usual size of block data 
 #define INF_GET_RAWDATA    10
 #define INF_GET_BLOCKNUM   11
 
@@ -37,8 +36,16 @@ RIDFPull::RIDFPull(std::string host){
 
 RIDFPull::~RIDFPull(){
   //  delete data;
+  disconnect();
 };
 
+void RIDFPull::disconnect(void){
+  if(sock){
+    close(sock);
+    sock = 0;
+  }
+}
+
 int RIDFPull::mktcpsend(char *host, unsigned short port){
   int tsock = 0;
   struct hostent *thp;
@@ -70,15 +77,41 @@ int RIDFPull::mktcpsend(char *host, unsigned short port){
   return tsock;
 }
 
-int RIDFPull::eb_get(int sock, int com, char *dest){
-  int len;
+// -1 : send/recv error or connection closed
+// -2 : reply larger than maxlen (read into dest and discarded, the
+//      connection stays usable)
+int RIDFPull::eb_get(int sock, int com, char *dest, int maxlen){
+  int len, n;
+  int req[2];
 
-  len = sizeof(com);
-  send(sock, (char *)&len, sizeof(len), 0);
-  send(sock, (char *)&com, len, 0);
+  // length and command in one segment: two small writes on a kept-alive
+  // connection would wait for the delayed ACK (Nagle)
+  req[0] = sizeof(com);
+  req[1] = com;
+  if(send(sock, (char *)req, sizeof(req), MSG_NOSIGNAL) != (ssize_t)sizeof(req)){
+    return -1;
+  }
 
-  recv(sock, (char *)&len, sizeof(len), MSG_WAITALL);
-  recv(sock, dest, len, MSG_WAITALL);
+  if(recv(sock, (char *)&len, sizeof(len), MSG_WAITALL) != (ssize_t)sizeof(len)){
+    return -1;
+  }
+  if(len < 0){
+    return -1;
+  }
+  if(len > maxlen){
+    printf("RIDFPull: reply of %d bytes exceeds buffer (%d bytes), skipped\n", len, maxlen);
+    while(len > 0){
+      n = len < maxlen ? len : maxlen;
+      if(recv(sock, dest, n, MSG_WAITALL) != (ssize_t)n){
+	return -1;
+      }
+      len -= n;
+    }
+    return -2;
+  }
+  if(len > 0 && recv(sock, dest, len, MSG_WAITALL) != (ssize_t)len){
+    return -1;
+  }
 
   return len;
 }
@@ -95,43 +128,157 @@ int RIDFPull::infcon(char *host){
   return infsock;
 }
 
+// Connect with the cached babinfo address, the host name is resolved only once
+int RIDFPull::connectinf(void){
+  int tsock;
+  struct hostent *thp;
+  struct sockaddr_in tsaddr;
+  struct timeval tv;
+
+  if(!ebresolved){
+    if((thp = gethostbyname(ebhostname)) == NULL || thp->h_length != sizeof(ebaddr)){
+      printf("bi-tcp.mktcpsend : No such host (%s)\n", ebhostname);
+      return 0;
+    }
+    memcpy(&ebaddr, thp->h_addr, sizeof(ebaddr));
+    ebresolved = 1;
+  }
+
+  if((tsock = socket(AF_INET,SOCK_STREAM,0)) < 0){
+    perror("bi-tcp.mktcpsend: Can't make socket.\n");
+    return 0;
+  }
+
+  // a stalled babinfo must not block the analyzer forever
+  tv.tv_sec = 5;
+  tv.tv_usec = 0;
+  setsockopt(tsock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(tsock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+  memset((char *)&tsaddr,0,sizeof(tsaddr));
+  memcpy(&tsaddr.sin_addr, &ebaddr, sizeof(ebaddr));
+  tsaddr.sin_family = AF_INET;
+  tsaddr.sin_port = htons(INFCOMPORT);
+
+  if(connect(tsock,(struct sockaddr *)&tsaddr,sizeof(tsaddr)) < 0){
+    perror("bi-tcp.mktcpsend: Error in tcp connect.\n");
+    close(tsock);
+    return 0;
+  }
+
+  if(nconnect++){
+    stats.reconnects++;
+  }
+  return tsock;
+}
+
+// Send one command on the persistent connection. A connection closed by
+// babinfo (idle timeout, restart, one command per connection) is replaced
+// and the command is retried once. -2 : reply larger than maxlen
+int RIDFPull::command(int com, char *dest, int maxlen){
+  int i, len;
+  char c;
+  struct pollfd pfd;
+
+  for(i=0;i<2;i++){
+    if(sock){
+      // drop the connection if the peer already closed it
+      pfd.fd = sock;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      if(poll(&pfd, 1, 0) > 0 && recv(sock, &c, 1, MSG_PEEK | MSG_DONTWAIT) <= 0){
+	disconnect();
+      }
+    }
+    if(!sock){
+      if(!(sock = connectinf())){
+	printf("Can't connect to babinfo.\n");
+	return -1;
+      }
+    }
 
-// 0  : no new data / or no valid data
+    len = eb_get(sock, com, dest, maxlen);
+    if(len >= 0 || len == -2){
+      return len;
+    }
+    disconnect();
+  }
+
+  return -1;
+}
+
+
+// 0  : no new data / or no valid data (or a block larger than bufsz, skipped)
 // sz : data size
 // -1 : error
-int RIDFPull::pull(char *data){
+int RIDFPull::pull(char *data, int bufsz){
   int tblkn = 0;
   int thd, cid = 0;
   int ret = 0;
   int size;
-
-  sock = 0;
+  int ibn = 0, len;
 
   if(!data){
     printf("data buffer is not malloced\n");
     return -1;
   }
-    
+  stats.polls++;
+  stats.connected = 0;
+
+  /* Block number first, the raw block is fetched only when it changed */
+  if(command(INF_GET_BLOCKNUM, (char *)&ibn, sizeof(ibn)) != (int)sizeof(ibn)){
+    printf("Can not connect %s\n", ebhostname);
+    stats.errors++;
+    return -1;
+  }
+  stats.connected = 1;
+  if(infblknok && ibn == infblkn){
+    return 0;
+  }
+
   /* List Data Socket */
-  if((sock = infcon(ebhostname))){
-    eb_get(sock, INF_GET_RAWDATA, data);
-    close(sock);
-  }else{
+  len = command(INF_GET_RAWDATA, data, bufsz);
+  if(len == -2){
+    // block larger than the buffer: skip it, it is not fetched again
+    stats.errors++;
+    infblkn = ibn;
+    infblknok = 1;
+    return 0;
+  }
+  if(len < 0){
     printf("Can not connect %s\n", ebhostname);
+    stats.errors++;
+    stats.connected = 0;
     return -1;
   }
+  infblkn = ibn;
+  infblknok = 1;
+
+  if(len < 20){
+    return 0;
+  }
 
   memcpy((char *)&size, data, sizeof(size));
   size = size & 0x003fffff;
+  if(size * 2 > len){
+    return 0;
+  }
   
   memcpy((char *)&thd, data+8, sizeof(thd));
   cid = RIDF_CI(thd);
 
   if(cid == 8){
     memcpy((char *)&tblkn, data+16, sizeof(tblkn));
-    if(tblkn != blkn){
+    if(!blknok || tblkn != blkn){
+      // blocks the DAQ built between two polls were never seen here
+      if(blknok && tblkn > blkn + 1){
+	stats.skipped += tblkn - blkn - 1;
+      }
       blkn = tblkn;
+      blknok = 1;
       ret = size * 2;
+      stats.blocks++;
+      stats.bytes += ret;
     }else{
       ret = 0;
     }
@@ -141,4 +288,3 @@ int RIDFPull::pull(char *data){
 
   return ret;
 }
-
@@ -0,0 +1,165 @@
+#include "RIDFPullMux.h"
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+RIDFPullMux::RIDFPullMux(int n, int sz)
+  : bufsz(sz){
+  int i;
+
+  if(n < 2){
+    n = 2;
+  }
+  for(i=0;i<n;i++){
+    bufs.push_back((char *)malloc(bufsz));
+    sizes.push_back(0);
+    srcs.push_back(-1);
+    freebufs.push_back(i);
+  }
+}
+
+RIDFPullMux::~RIDFPullMux(){
+  stop();
+  for(RIDFPull *p : pullers){
+    delete p;
+  }
+  for(char *b : bufs){
+    free(b);
+  }
+}
+
+int RIDFPullMux::addhost(const char *host){
+  if(!threads.empty()){
+    return -1;
+  }
+  pullers.push_back(new RIDFPull(std::string(host)));
+  hoststats.push_back(ridfpull_stats{});
+  return (int)pullers.size() - 1;
+}
+
+const char *RIDFPullMux::hostname(int src){
+  if(src < 0 || src >= (int)pullers.size()){
+    return NULL;
+  }
+  return pullers[src]->hostname();
+}
+
+int RIDFPullMux::start(void){
+  int i;
+
+  if(!threads.empty()){
+    return 0;
+  }
+
+  quit = 0;
+  for(i=0;i<(int)pullers.size();i++){
+    threads.push_back(new std::thread(&RIDFPullMux::run, this, i));
+  }
+
+  return 1;
+}
+
+int RIDFPullMux::stop(void){
+  if(threads.empty()){
+    return 0;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    quit = 1;
+  }
+  cv.notify_all();
+  for(std::thread *th : threads){
+    th->join();
+    delete th;
+  }
+  threads.clear();
+
+  return 1;
+}
+
+void RIDFPullMux::run(int src){
+  RIDFPull *puller = pullers[src];
+  int buf, sz;
+  int backoff_ms = 1;
+  const int max_backoff_ms = 10;
+  const int retry_ms = 1000;
+
+  while(1){
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      cv.wait(lock, [this]{ return quit || !freebufs.empty(); });
+      if(quit){
+	return;
+      }
+      buf = freebufs.back();
+      freebufs.pop_back();
+    }
+
+    // pull without holding the lock, the buffer belongs to this thread now
+    sz = puller->pull(bufs[buf], bufsz);
+
+    std::unique_lock<std::mutex> lock(mtx);
+    puller->getstats(&hoststats[src]);
+    if(sz > 0){
+      sizes[buf] = sz;
+      srcs[buf] = src;
+      ready.push_back(buf);
+      backoff_ms = 1;
+      continue;
+    }
+
+    freebufs.push_back(buf);
+    cv.notify_all();
+    if(sz < 0){
+      // host down: retry later, the other hosts keep running
+      cv.wait_for(lock, std::chrono::milliseconds(retry_ms), [this]{ return quit != 0; });
+    }else{
+      cv.wait_for(lock, std::chrono::milliseconds(backoff_ms), [this]{ return quit != 0; });
+      backoff_ms = std::min(backoff_ms * 2, max_backoff_ms);
+    }
+    if(quit){
+      return;
+    }
+  }
+}
+
+int RIDFPullMux::next(char **blk, int *src){
+  int cur;
+  std::lock_guard<std::mutex> lock(mtx);
+
+  if(held >= 0){
+    freebufs.push_back(held);
+    held = -1;
+    cv.notify_all();
+  }
+
+  if(ready.empty()){
+    return 0;
+  }
+
+  cur = ready.front();
+  ready.pop_front();
+  held = cur;
+  *blk = bufs[cur];
+  *src = srcs[cur];
+
+  return sizes[cur];
+}
+
+int RIDFPullMux::getstats(int src, struct ridfpull_stats *st){
+  std::lock_guard<std::mutex> lock(mtx);
+
+  if(src < 0 || src >= (int)hoststats.size()){
+    return -1;
+  }
+  *st = hoststats[src];
+
+  return 0;
+}
+
+int RIDFPullMux::depth(void){
+  std::lock_guard<std::mutex> lock(mtx);
+  return (int)ready.size();
+}
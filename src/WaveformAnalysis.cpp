@@ -9,6 +9,7 @@
 #include <sstream>
 #include <vector>
 
+#include "WaveformKernels.h"
 #include "nlohmann/json.hpp"
 
 namespace {
@@ -189,6 +190,39 @@ void parseConfigNode(const json &node, ConfigNode &cfg_node, const std::string &
     }
   }
 
+  if (node.contains("zero_suppression")) {
+    const auto &v = node.at("zero_suppression");
+    if (v.is_boolean()) {
+      cfg_node.zero_suppression = v.get<bool>();
+    } else {
+      std::cerr << "Warning [" << context << "]: zero_suppression must be boolean, using default\n";
+    }
+  }
+  if (node.contains("zs_nsigma")) {
+    const auto &v = node.at("zs_nsigma");
+    if (v.is_number()) {
+      cfg_node.zs_nsigma = v.get<double>();
+    } else {
+      std::cerr << "Warning [" << context << "]: zs_nsigma must be number, using default\n";
+    }
+  }
+  if (node.contains("roi_pre")) {
+    const auto &v = node.at("roi_pre");
+    if (v.is_number_integer()) {
+      cfg_node.roi_pre = v.get<int>();
+    } else {
+      std::cerr << "Warning [" << context << "]: roi_pre must be integer, using default\n";
+    }
+  }
+  if (node.contains("roi_post")) {
+    const auto &v = node.at("roi_post");
+    if (v.is_number_integer()) {
+      cfg_node.roi_post = v.get<int>();
+    } else {
+      std::cerr << "Warning [" << context << "]: roi_post must be integer, using default\n";
+    }
+  }
+
   if (cfg_node.cfd_store_mode.has_value() && cfg_node.store_cfd_array.has_value()) {
     std::cerr << "Warning [" << context
               << "]: both cfd_store_mode and store_cfd_array specified; cfd_store_mode takes precedence\n";
@@ -246,6 +280,18 @@ void applyNode(const ConfigNode &node, ResolvedAnalysisParams &params) {
   } else if (node.dcfd_fraction.has_value()) {
     params.dcfd_target_percent = fractionToNearestPercent10(node.dcfd_fraction.value());
   }
+  if (node.zero_suppression.has_value()) {
+    params.zero_suppression = node.zero_suppression.value();
+  }
+  if (node.zs_nsigma.has_value()) {
+    params.zs_nsigma = node.zs_nsigma.value();
+  }
+  if (node.roi_pre.has_value()) {
+    params.roi_pre = node.roi_pre.value();
+  }
+  if (node.roi_post.has_value()) {
+    params.roi_post = node.roi_post.value();
+  }
 }
 
 bool sanitizeAnalysisParams(ResolvedAnalysisParams &params) {
@@ -280,6 +326,14 @@ bool sanitizeAnalysisParams(ResolvedAnalysisParams &params) {
     params.dcfd_target_percent = 30;
   }
 
+  if (!(params.zs_nsigma > 0.0)) {
+    params.zs_nsigma = 3.0;
+  }
+  params.roi_post = std::max(params.roi_post, 0);
+  // a cropped trace is analyzed with the same baseline window, so the
+  // samples kept before the peak must cover it
+  params.roi_pre = std::max(params.roi_pre, (params.roi_post > 0) ? params.baseline_end : 0);
+
   return true;
 }
 
@@ -288,58 +342,67 @@ bool computeBaseline(const short *wf, int nsample, int start, int end, float &ba
     return false;
   }
 
-  const int count = end - start;
-  double sum = 0.0;
-  for (int i = start; i < end; i++) {
-    sum += wf[i];
-  }
-  const double mean = sum / static_cast<double>(count);
-
-  double sqsum = 0.0;
-  for (int i = start; i < end; i++) {
-    const double d = static_cast<double>(wf[i]) - mean;
-    sqsum += d * d;
-  }
+  // one pass with exact integer sums: count^2 * variance = count * sumsq - sum^2
+  // (up to ~2^92 for full-range samples, past long long beyond ~92k samples)
+  const long long count = end - start;
+  long long sum = 0;
+  long long sumsq = 0;
+  waveformSampleSums(wf + start, end - start, sum, sumsq);
+  const double mean = static_cast<double>(sum) / static_cast<double>(count);
+  const __int128 scaled_var = static_cast<__int128>(count) * sumsq - static_cast<__int128>(sum) * sum;
 
   baseline = static_cast<float>(mean);
-  rms = static_cast<float>(std::sqrt(sqsum / static_cast<double>(count)));
+  rms = static_cast<float>(std::sqrt(static_cast<double>(scaled_var)) / static_cast<double>(count));
   return true;
 }
 
-int findPeakIndex(const std::vector<double> &normalized, double &amplitude) {
-  if (normalized.empty()) {
+int findPeakIndex(const double *normalized, int n, double &amplitude) {
+  if (n <= 0) {
     amplitude = 0.0;
     return -1;
   }
 
-  auto it = std::max_element(normalized.begin(), normalized.end());
-  amplitude = *it;
-  return static_cast<int>(std::distance(normalized.begin(), it));
+  const int peak = waveformArgMax(normalized, n);
+  amplitude = normalized[peak];
+  return peak;
 }
 
-std::vector<double> applyMovingAverage(const std::vector<double> &input, int window_size) {
-  if (window_size <= 1 || input.empty()) {
-    return input;
+// Centered moving average (window shrinks at the ends) as a running sum,
+// written over the input. ring keeps the inputs that are already replaced
+// but still inside the window.
+void applyMovingAverage(double *x, int n, int window_size, std::vector<double> &ring) {
+  if (window_size <= 1 || n <= 0) {
+    return;
   }
 
-  const int n = static_cast<int>(input.size());
-  std::vector<double> output(n);
   const int half_window = window_size / 2;
+  const int nring = half_window + 1;
+  if (static_cast<int>(ring.size()) < nring) {
+    ring.resize(nring);
+  }
 
+  double sum = 0.0;
+  for (int j = 0; j < std::min(n, half_window + 1); j++) {
+    sum += x[j];
+  }
   for (int i = 0; i < n; i++) {
     const int start = std::max(0, i - half_window);
     const int end = std::min(n, i + half_window + 1);
-    double sum = 0.0;
-    for (int j = start; j < end; j++) {
-      sum += input[j];
+    ring[i % nring] = x[i];
+    x[i] = sum / static_cast<double>(end - start);
+
+    // slide to i + 1
+    if (i + half_window + 1 < n) {
+      sum += x[i + half_window + 1];
+    }
+    if (i - half_window >= 0) {
+      sum -= ring[(i - half_window) % nring];
     }
-    output[i] = sum / static_cast<double>(end - start);
   }
-  return output;
 }
 
-float computeCFDTime(const std::vector<double> &normalized, int peak_idx, double threshold, double sample_rate_ns) {
-  if (peak_idx <= 0 || peak_idx >= static_cast<int>(normalized.size())) {
+float computeCFDTime(const double *normalized, int n, int peak_idx, double threshold, double sample_rate_ns) {
+  if (peak_idx <= 0 || peak_idx >= n) {
     return -1.0f;
   }
 
@@ -364,9 +427,8 @@ float computeCFDTime(const std::vector<double> &normalized, int peak_idx, double
   return -1.0f;
 }
 
-float computeDCFDTime(const std::vector<double> &normalized, int baseline_end, int peak_idx, int delay,
+float computeDCFDTime(const double *normalized, int n, int baseline_end, int peak_idx, int delay,
                       double fraction, double sample_rate_ns) {
-  const int n = static_cast<int>(normalized.size());
   const int search_start = std::max(baseline_end, delay);
   const int search_end = std::min(peak_idx, n - 1);
 
@@ -423,6 +485,10 @@ bool writeTemplateConfig(const std::string &path, std::string *error_message) {
       {"dcfd_target_percent", 30},
       {"dcfd_enabled", false},
       {"dcfd_delay", 3},
+      {"zero_suppression", false},
+      {"zs_nsigma", 3.0},
+      {"roi_pre", 0},
+      {"roi_post", 0},
   };
   j["detectors"]["default"] = {
       {"enabled", true},
@@ -541,6 +607,10 @@ ResolvedAnalysisParams resolveAnalysisParams(const AnalysisConfig &config, int d
   params.dcfd_store_mode = "single";
   params.cfd_target_percent = 50;
   params.dcfd_target_percent = 30;
+  params.zero_suppression = false;
+  params.zs_nsigma = 3.0;
+  params.roi_pre = 0;
+  params.roi_post = 0;
 
   applyNode(config.global, params);
   applyNode(config.default_detector, params);
@@ -562,23 +632,73 @@ bool validateBaselineRange(const ResolvedAnalysisParams &params, int nsample) {
          (params.baseline_end <= nsample);
 }
 
+CompiledAnalysisParams compileAnalysisParams(const ResolvedAnalysisParams &params) {
+  ResolvedAnalysisParams safe_params = params;
+  CompiledAnalysisParams out;
+  out.valid = sanitizeAnalysisParams(safe_params);
+  out.enabled = safe_params.enabled;
+  out.sample_rate_ns = safe_params.sample_rate_ns;
+  out.polarity = safe_params.polarity;
+  out.sign = (safe_params.polarity == SignalPolarity::Negative) ? -1.0 : 1.0;
+  out.baseline_start = safe_params.baseline_start;
+  out.baseline_end = safe_params.baseline_end;
+  out.ma_window_size = safe_params.ma_window_size;
+  out.dcfd_enabled = safe_params.dcfd_enabled;
+  out.dcfd_delay = safe_params.dcfd_delay;
+  out.cfd_store_mode = (safe_params.cfd_store_mode == "array") ? StoreMode::Array : StoreMode::Single;
+  out.dcfd_store_mode = (safe_params.dcfd_store_mode == "array") ? StoreMode::Array : StoreMode::Single;
+  out.cfd_target_index = (safe_params.cfd_target_percent / 10) - 1;
+  out.cfd_target_fraction = percentToFraction(safe_params.cfd_target_percent);
+  out.dcfd_target_fraction = percentToFraction(safe_params.dcfd_target_percent);
+  out.zero_suppression = safe_params.zero_suppression;
+  out.zs_nsigma = safe_params.zs_nsigma;
+  out.roi_pre = safe_params.roi_pre;
+  out.roi_post = safe_params.roi_post;
+  return out;
+}
+
+void AnalysisParamTable::compile(const AnalysisConfig &config) {
+  ndet_ = 64;
+  for (const auto &kv : config.detectors) {
+    ndet_ = std::max(ndet_, kv.first + 1);
+  }
+
+  const size_t nrow = static_cast<size_t>(ndet_) * kRowSize + 1;
+  resolved_.resize(nrow);
+  compiled_.resize(nrow);
+  for (int det = 0; det < ndet_; det++) {
+    for (int k = 0; k < kRowSize; k++) {
+      // last column: channels without their own config node
+      const int ch = (k < kRowSize - 1) ? k : -1;
+      const size_t i = static_cast<size_t>(det) * kRowSize + k;
+      resolved_[i] = resolveAnalysisParams(config, det, ch);
+      compiled_[i] = compileAnalysisParams(resolved_[i]);
+    }
+  }
+  // detectors outside the table: not in config.detectors
+  resolved_[nrow - 1] = resolveAnalysisParams(config, -1, -1);
+  compiled_[nrow - 1] = compileAnalysisParams(resolved_[nrow - 1]);
+}
+
 WaveformAnalysisResult analyzeWaveform(const short *wf, int nsample, const ResolvedAnalysisParams &params) {
+  return analyzeWaveform(wf, nsample, compileAnalysisParams(params));
+}
+
+WaveformAnalysisResult analyzeWaveform(const short *wf, int nsample, const CompiledAnalysisParams &params) {
+  WaveformScratch scratch;
+  return analyzeWaveform(wf, nsample, params, scratch);
+}
+
+WaveformAnalysisResult analyzeWaveform(const short *wf, int nsample, const CompiledAnalysisParams &params,
+                                       WaveformScratch &scratch) {
   WaveformAnalysisResult out;
   out.cfd_time_ns = -1.0f;
   out.dcfd_time_ns = -1.0f;
   out.risetime = quietNaN();
 
-  ResolvedAnalysisParams safe_params = params;
-  if (!sanitizeAnalysisParams(safe_params)) {
-    out.baseline = quietNaN();
-    out.baseline_rms = quietNaN();
-    out.amplitude = quietNaN();
-    out.peak_time_ns = quietNaN();
-    out.valid = false;
-    return out;
-  }
-
-  if (!safe_params.enabled || wf == nullptr || nsample <= 0 || !validateBaselineRange(safe_params, nsample)) {
+  const bool baseline_in_range = (params.baseline_start >= 0) && (params.baseline_start < params.baseline_end) &&
+                                 (params.baseline_end <= nsample);
+  if (!params.valid || !params.enabled || wf == nullptr || nsample <= 0 || !baseline_in_range) {
     out.baseline = quietNaN();
     out.baseline_rms = quietNaN();
     out.amplitude = quietNaN();
@@ -589,8 +709,7 @@ WaveformAnalysisResult analyzeWaveform(const short *wf, int nsample, const Resol
 
   float baseline = 0.0f;
   float baseline_rms = 0.0f;
-  if (!computeBaseline(wf, nsample, safe_params.baseline_start, safe_params.baseline_end, baseline,
-                       baseline_rms)) {
+  if (!computeBaseline(wf, nsample, params.baseline_start, params.baseline_end, baseline, baseline_rms)) {
     out.baseline = quietNaN();
     out.baseline_rms = quietNaN();
     out.amplitude = quietNaN();
@@ -599,18 +718,17 @@ WaveformAnalysisResult analyzeWaveform(const short *wf, int nsample, const Resol
     return out;
   }
 
-  const double sign = (safe_params.polarity == SignalPolarity::Negative) ? -1.0 : 1.0;
-  std::vector<double> normalized;
-  normalized.reserve(nsample);
-  for (int i = 0; i < nsample; i++) {
-    normalized.push_back((static_cast<double>(wf[i]) - baseline) * sign);
+  if (static_cast<int>(scratch.normalized.size()) < nsample) {
+    scratch.normalized.resize(nsample);
   }
-  if (safe_params.ma_window_size > 1) {
-    normalized = applyMovingAverage(normalized, safe_params.ma_window_size);
+  double *normalized = scratch.normalized.data();
+  waveformSubtractBaseline(wf, nsample, baseline, params.sign, normalized);
+  if (params.ma_window_size > 1) {
+    applyMovingAverage(normalized, nsample, params.ma_window_size, scratch.ring);
   }
 
   double amplitude = 0.0;
-  const int peak_idx = findPeakIndex(normalized, amplitude);
+  const int peak_idx = findPeakIndex(normalized, nsample, amplitude);
   if (peak_idx < 0 || amplitude <= 0.0) {
     out.baseline = baseline;
     out.baseline_rms = baseline_rms;
@@ -622,26 +740,24 @@ WaveformAnalysisResult analyzeWaveform(const short *wf, int nsample, const Resol
   }
 
   static constexpr std::array<int, 9> kPercents = {10, 20, 30, 40, 50, 60, 70, 80, 90};
-  if (safe_params.cfd_store_mode == "array") {
+  if (params.cfd_store_mode == StoreMode::Array) {
     for (size_t i = 0; i < kPercents.size(); i++) {
       const double threshold = amplitude * percentToFraction(kPercents[i]);
-      out.cfd_times[i] = computeCFDTime(normalized, peak_idx, threshold, safe_params.sample_rate_ns);
+      out.cfd_times[i] = computeCFDTime(normalized, nsample, peak_idx, threshold, params.sample_rate_ns);
     }
-    out.cfd_time_ns = out.cfd_times[static_cast<size_t>((safe_params.cfd_target_percent / 10) - 1)];
+    out.cfd_time_ns = out.cfd_times[static_cast<size_t>(params.cfd_target_index)];
   } else {
-    const double threshold = amplitude * percentToFraction(safe_params.cfd_target_percent);
-    out.cfd_time_ns = computeCFDTime(normalized, peak_idx, threshold, safe_params.sample_rate_ns);
+    const double threshold = amplitude * params.cfd_target_fraction;
+    out.cfd_time_ns = computeCFDTime(normalized, nsample, peak_idx, threshold, params.sample_rate_ns);
   }
 
-  if (safe_params.dcfd_enabled && peak_idx > 0) {
-    out.dcfd_time_ns =
-        computeDCFDTime(normalized, safe_params.baseline_end, peak_idx, safe_params.dcfd_delay,
-                        percentToFraction(safe_params.dcfd_target_percent), safe_params.sample_rate_ns);
-    if (safe_params.dcfd_store_mode == "array") {
+  if (params.dcfd_enabled && peak_idx > 0) {
+    out.dcfd_time_ns = computeDCFDTime(normalized, nsample, params.baseline_end, peak_idx, params.dcfd_delay,
+                                       params.dcfd_target_fraction, params.sample_rate_ns);
+    if (params.dcfd_store_mode == StoreMode::Array) {
       for (size_t i = 0; i < kPercents.size(); i++) {
-        out.dcfd_times[i] = computeDCFDTime(normalized, safe_params.baseline_end, peak_idx,
-                                            safe_params.dcfd_delay, percentToFraction(kPercents[i]),
-                                            safe_params.sample_rate_ns);
+        out.dcfd_times[i] = computeDCFDTime(normalized, nsample, params.baseline_end, peak_idx, params.dcfd_delay,
+                                            percentToFraction(kPercents[i]), params.sample_rate_ns);
       }
     }
   }
@@ -656,7 +772,77 @@ WaveformAnalysisResult analyzeWaveform(const short *wf, int nsample, const Resol
   out.baseline_rms = baseline_rms;
   out.amplitude = static_cast<float>(amplitude);
   out.peak_sample = peak_idx;
-  out.peak_time_ns = static_cast<float>(peak_idx * safe_params.sample_rate_ns);
+  out.peak_time_ns = static_cast<float>(peak_idx * params.sample_rate_ns);
   out.valid = true;
   return out;
 }
+
+void shiftAnalysisResult(WaveformAnalysisResult &result, int sample_offset, const ResolvedAnalysisParams &params) {
+  if (sample_offset == 0) {
+    return;
+  }
+  const float dt = static_cast<float>(sample_offset * params.sample_rate_ns);
+  auto shift = [dt](float &t) {
+    if (t >= 0.0f) {
+      t += dt;
+    }
+  };
+  if (result.peak_sample >= 0) {
+    result.peak_sample += sample_offset;
+  }
+  shift(result.peak_time_ns);
+  shift(result.cfd_time_ns);
+  shift(result.dcfd_time_ns);
+  for (float &t : result.cfd_times) {
+    shift(t);
+  }
+  for (float &t : result.dcfd_times) {
+    shift(t);
+  }
+}
+
+SuppressionDecision evaluateSuppression(const short *wf, int nsample, const ResolvedAnalysisParams &params) {
+  return evaluateSuppression(wf, nsample, compileAnalysisParams(params));
+}
+
+SuppressionDecision evaluateSuppression(const short *wf, int nsample, const CompiledAnalysisParams &params) {
+  SuppressionDecision decision;
+  decision.crop_length = nsample;
+
+  if (!params.valid || (!params.zero_suppression && params.roi_post <= 0)) {
+    return decision;
+  }
+
+  float baseline = 0.0f;
+  float baseline_rms = 0.0f;
+  if (!computeBaseline(wf, nsample, params.baseline_start, params.baseline_end, baseline, baseline_rms)) {
+    // no baseline window inside the waveform: keep it as it is
+    return decision;
+  }
+
+  int peak = 0;
+  double peak_dev = (static_cast<double>(wf[0]) - baseline) * params.sign;
+  for (int i = 1; i < nsample; i++) {
+    const double dev = (static_cast<double>(wf[i]) - baseline) * params.sign;
+    if (dev > peak_dev) {
+      peak_dev = dev;
+      peak = i;
+    }
+  }
+
+  if (params.zero_suppression) {
+    const double threshold = params.zs_nsigma * static_cast<double>(baseline_rms);
+    if (!(peak_dev > 0.0 && peak_dev >= threshold)) {
+      decision.keep = false;
+      decision.crop_length = 0;
+      return decision;
+    }
+  }
+
+  if (params.roi_post > 0) {
+    decision.crop_start = std::max(0, peak - params.roi_pre);
+    const int crop_end = std::max(peak + params.roi_post, decision.crop_start + params.baseline_end);
+    decision.crop_length = std::min(nsample, crop_end) - decision.crop_start;
+  }
+  return decision;
+}
@@ -0,0 +1,267 @@
+#include "WaveformKernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define WAVEFORM_KERNELS_X86 1
+#endif
+#endif
+
+namespace {
+
+void sampleSumsScalar(const short *wf, int n, long long &sum, long long &sumsq) {
+  long long s = 0;
+  long long sq = 0;
+  for (int i = 0; i < n; i++) {
+    s += wf[i];
+    sq += static_cast<long long>(wf[i]) * wf[i];
+  }
+  sum = s;
+  sumsq = sq;
+}
+
+void subtractBaselineScalar(const short *wf, int n, double baseline, double sign, double *out) {
+  for (int i = 0; i < n; i++) {
+    out[i] = (static_cast<double>(wf[i]) - baseline) * sign;
+  }
+}
+
+int argMaxScalar(const double *x, int n) {
+  if (n <= 0) {
+    return -1;
+  }
+  int best = 0;
+  for (int i = 1; i < n; i++) {
+    if (x[i] > x[best]) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+// Lane maxima with the first index of each -> overall first maximum
+int reduceArgMax(const double *lane_max, const double *lane_idx, int nlane) {
+  int best = 0;
+  for (int k = 1; k < nlane; k++) {
+    if (lane_max[k] > lane_max[best] || (lane_max[k] == lane_max[best] && lane_idx[k] < lane_idx[best])) {
+      best = k;
+    }
+  }
+  return static_cast<int>(lane_idx[best]);
+}
+
+#ifdef WAVEFORM_KERNELS_X86
+// madd(v, v) gives pairs of squares in [0, 2^31], exact as unsigned 32-bit,
+// so they are zero-extended; madd(v, 1) pair sums are sign-extended.
+__attribute__((target("avx2"))) void sampleSumsAvx2(const short *wf, int n, long long &sum, long long &sumsq) {
+  const __m256i ones = _mm256_set1_epi16(1);
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i vsum = _mm256_setzero_si256();
+  __m256i vsq = _mm256_setzero_si256();
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(wf + i));
+    const __m256i s = _mm256_madd_epi16(v, ones);
+    vsum = _mm256_add_epi64(vsum, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(s)));
+    vsum = _mm256_add_epi64(vsum, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(s, 1)));
+    const __m256i sq = _mm256_madd_epi16(v, v);
+    vsq = _mm256_add_epi64(vsq, _mm256_unpacklo_epi32(sq, zero));
+    vsq = _mm256_add_epi64(vsq, _mm256_unpackhi_epi32(sq, zero));
+  }
+
+  long long tsum[4];
+  long long tsq[4];
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(tsum), vsum);
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(tsq), vsq);
+  sampleSumsScalar(wf + i, n - i, sum, sumsq);
+  for (int k = 0; k < 4; k++) {
+    sum += tsum[k];
+    sumsq += tsq[k];
+  }
+}
+
+__attribute__((target("avx2"))) void subtractBaselineAvx2(const short *wf, int n, double baseline, double sign,
+                                                          double *out) {
+  const __m256d vbase = _mm256_set1_pd(baseline);
+  const __m256d vsign = _mm256_set1_pd(sign);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(wf + i)));
+    const __m256d lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(v));
+    const __m256d hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1));
+    _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_sub_pd(lo, vbase), vsign));
+    _mm256_storeu_pd(out + i + 4, _mm256_mul_pd(_mm256_sub_pd(hi, vbase), vsign));
+  }
+  subtractBaselineScalar(wf + i, n - i, baseline, sign, out + i);
+}
+
+// Each lane keeps its first maximum (strictly greater replaces)
+__attribute__((target("avx2"))) int argMaxAvx2(const double *x, int n) {
+  if (n < 8) {
+    return argMaxScalar(x, n);
+  }
+  __m256d vmax = _mm256_loadu_pd(x);
+  __m256d vidx = _mm256_set_pd(3.0, 2.0, 1.0, 0.0);
+  __m256d vcur = vidx;
+  const __m256d step = _mm256_set1_pd(4.0);
+  int i = 4;
+  for (; i + 4 <= n; i += 4) {
+    vcur = _mm256_add_pd(vcur, step);
+    const __m256d v = _mm256_loadu_pd(x + i);
+    const __m256d gt = _mm256_cmp_pd(v, vmax, _CMP_GT_OQ);
+    vmax = _mm256_blendv_pd(vmax, v, gt);
+    vidx = _mm256_blendv_pd(vidx, vcur, gt);
+  }
+
+  double lane_max[4];
+  double lane_idx[4];
+  _mm256_storeu_pd(lane_max, vmax);
+  _mm256_storeu_pd(lane_idx, vidx);
+  int best = reduceArgMax(lane_max, lane_idx, 4);
+  for (; i < n; i++) {
+    if (x[i] > x[best]) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+__attribute__((target("avx512f,avx512bw"))) void sampleSumsAvx512(const short *wf, int n, long long &sum,
+                                                                   long long &sumsq) {
+  const __m512i ones = _mm512_set1_epi16(1);
+  const __m512i zero = _mm512_setzero_si512();
+  __m512i vsum = _mm512_setzero_si512();
+  __m512i vsq = _mm512_setzero_si512();
+  int i = 0;
+  for (; i + 32 <= n; i += 32) {
+    const __m512i v = _mm512_loadu_si512(wf + i);
+    const __m512i s = _mm512_madd_epi16(v, ones);
+    vsum = _mm512_add_epi64(vsum, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(s)));
+    vsum = _mm512_add_epi64(vsum, _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(s, 1)));
+    const __m512i sq = _mm512_madd_epi16(v, v);
+    vsq = _mm512_add_epi64(vsq, _mm512_unpacklo_epi32(sq, zero));
+    vsq = _mm512_add_epi64(vsq, _mm512_unpackhi_epi32(sq, zero));
+  }
+
+  sampleSumsScalar(wf + i, n - i, sum, sumsq);
+  sum += _mm512_reduce_add_epi64(vsum);
+  sumsq += _mm512_reduce_add_epi64(vsq);
+}
+
+__attribute__((target("avx512f,avx512bw"))) void subtractBaselineAvx512(const short *wf, int n, double baseline,
+                                                                        double sign, double *out) {
+  const __m512d vbase = _mm512_set1_pd(baseline);
+  const __m512d vsign = _mm512_set1_pd(sign);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m512i v = _mm512_cvtepi16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(wf + i)));
+    const __m512d lo = _mm512_cvtepi32_pd(_mm512_castsi512_si256(v));
+    const __m512d hi = _mm512_cvtepi32_pd(_mm512_extracti64x4_epi64(v, 1));
+    _mm512_storeu_pd(out + i, _mm512_mul_pd(_mm512_sub_pd(lo, vbase), vsign));
+    _mm512_storeu_pd(out + i + 8, _mm512_mul_pd(_mm512_sub_pd(hi, vbase), vsign));
+  }
+  subtractBaselineScalar(wf + i, n - i, baseline, sign, out + i);
+}
+
+__attribute__((target("avx512f,avx512bw"))) int argMaxAvx512(const double *x, int n) {
+  if (n < 16) {
+    return argMaxScalar(x, n);
+  }
+  __m512d vmax = _mm512_loadu_pd(x);
+  __m512d vidx = _mm512_set_pd(7.0, 6.0, 5.0, 4.0, 3.0, 2.0, 1.0, 0.0);
+  __m512d vcur = vidx;
+  const __m512d step = _mm512_set1_pd(8.0);
+  int i = 8;
+  for (; i + 8 <= n; i += 8) {
+    vcur = _mm512_add_pd(vcur, step);
+    const __m512d v = _mm512_loadu_pd(x + i);
+    const __mmask8 gt = _mm512_cmp_pd_mask(v, vmax, _CMP_GT_OQ);
+    vmax = _mm512_mask_blend_pd(gt, vmax, v);
+    vidx = _mm512_mask_blend_pd(gt, vidx, vcur);
+  }
+
+  double lane_max[8];
+  double lane_idx[8];
+  _mm512_storeu_pd(lane_max, vmax);
+  _mm512_storeu_pd(lane_idx, vidx);
+  int best = reduceArgMax(lane_max, lane_idx, 8);
+  for (; i < n; i++) {
+    if (x[i] > x[best]) {
+      best = i;
+    }
+  }
+  return best;
+}
+#endif
+
+struct KernelImpl {
+  void (*sample_sums)(const short *, int, long long &, long long &);
+  void (*subtract_baseline)(const short *, int, double, double, double *);
+  int (*arg_max)(const double *, int);
+  const char *name;
+};
+
+const KernelImpl kScalar = {sampleSumsScalar, subtractBaselineScalar, argMaxScalar, "scalar"};
+#ifdef WAVEFORM_KERNELS_X86
+const KernelImpl kAvx2 = {sampleSumsAvx2, subtractBaselineAvx2, argMaxAvx2, "avx2"};
+const KernelImpl kAvx512 = {sampleSumsAvx512, subtractBaselineAvx512, argMaxAvx512, "avx512"};
+
+bool cpuHasAvx512() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+}
+
+bool cpuHasAvx2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+#endif
+
+KernelImpl selectDefault() {
+#ifdef WAVEFORM_KERNELS_X86
+  if (cpuHasAvx512()) {
+    return kAvx512;
+  }
+  if (cpuHasAvx2()) {
+    return kAvx2;
+  }
+#endif
+  return kScalar;
+}
+
+KernelImpl &current() {
+  static KernelImpl impl = selectDefault();
+  return impl;
+}
+
+} // namespace
+
+void waveformSampleSums(const short *wf, int n, long long &sum, long long &sumsq) {
+  current().sample_sums(wf, n, sum, sumsq);
+}
+
+void waveformSubtractBaseline(const short *wf, int n, double baseline, double sign, double *out) {
+  current().subtract_baseline(wf, n, baseline, sign, out);
+}
+
+int waveformArgMax(const double *x, int n) { return current().arg_max(x, n); }
+
+const char *waveformKernelsImpl() { return current().name; }
+
+bool selectWaveformKernels(const std::string &name) {
+  if (name == "scalar") {
+    current() = kScalar;
+    return true;
+  }
+#ifdef WAVEFORM_KERNELS_X86
+  if (name == "avx2" && cpuHasAvx2()) {
+    current() = kAvx2;
+    return true;
+  }
+  if (name == "avx512" && cpuHasAvx512()) {
+    current() = kAvx512;
+    return true;
+  }
+#endif
+  return false;
+}
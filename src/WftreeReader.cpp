@@ -0,0 +1,206 @@
+#include "WftreeReader.h"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+#include <TBranch.h>
+#include <TTree.h>
+
+#include "WaveformCodec.h"
+
+namespace {
+
+constexpr int kChannelLayoutMaxSamples = 4096;
+
+} // namespace
+
+bool WftreeReader::open(TTree *tree, std::string *error_message) {
+  tree_ = tree;
+  entries_ = tree->GetEntries();
+  loaded_entry_ = -1;
+  layout_ = (tree->GetBranch("nch") != nullptr) ? WftreeLayout::Event : WftreeLayout::Channel;
+  packed_ = (tree->GetBranch("wfpk") != nullptr);
+  cropped_ = (tree->GetBranch("crop_start") != nullptr);
+
+  std::vector<const char *> required = {"evtn", "det", "ch", "nsample"};
+  if (packed_) {
+    required.push_back("nwfpk");
+  } else {
+    required.push_back("wf");
+  }
+  if (layout_ == WftreeLayout::Event) {
+    required.push_back("offset");
+    required.push_back("nwf");
+    if (packed_) {
+      required.push_back("pkoffset");
+    }
+  }
+  for (const char *name : required) {
+    if (tree->GetBranch(name) == nullptr) {
+      if (error_message != nullptr) {
+        *error_message = std::string("wftree has no branch '") + name + "'";
+      }
+      return false;
+    }
+  }
+
+  tree->SetBranchAddress("evtn", &evtn_, &b_evtn_);
+  if (packed_) {
+    tree->SetBranchAddress("nwfpk", &nwfpk_, &b_nwfpk_);
+    reservePacked(static_cast<int>(waveformCodecMaxBytes(kChannelLayoutMaxSamples)));
+  }
+  if (layout_ == WftreeLayout::Event) {
+    tree->SetBranchAddress("nch", &nch_, &b_nch_);
+    tree->SetBranchAddress("nwf", &nwf_, &b_nwf_);
+    reserveChannels(64);
+    reserveSamples(64 * kChannelLayoutMaxSamples);
+  } else {
+    // one channel per entry: the scalars are read straight into element 0
+    nch_ = 1;
+    det_.resize(1);
+    ch_.resize(1);
+    nsample_.resize(1);
+    offset_.assign(1, 0);
+    pkoffset_.assign(1, 0);
+    crop_start_.assign(1, 0);
+    tree->SetBranchAddress("det", det_.data(), &b_det_);
+    tree->SetBranchAddress("ch", ch_.data(), &b_ch_);
+    tree->SetBranchAddress("nsample", nsample_.data(), &b_nsample_);
+    if (cropped_) {
+      tree->SetBranchAddress("crop_start", crop_start_.data(), &b_crop_start_);
+    }
+    reserveSamples(kChannelLayoutMaxSamples);
+  }
+  return true;
+}
+
+int WftreeReader::maxSamples() const {
+  return (layout_ == WftreeLayout::Channel && !packed_) ? kChannelLayoutMaxSamples
+                                                       : std::numeric_limits<int>::max();
+}
+
+void WftreeReader::reserveChannels(int nch) {
+  if (nch <= static_cast<int>(det_.size())) {
+    return;
+  }
+  const size_t n = std::max(static_cast<size_t>(nch), 2 * det_.size());
+  det_.resize(n);
+  ch_.resize(n);
+  nsample_.resize(n);
+  offset_.resize(n);
+  crop_start_.resize(n, 0);
+  tree_->SetBranchAddress("det", det_.data(), &b_det_);
+  tree_->SetBranchAddress("ch", ch_.data(), &b_ch_);
+  tree_->SetBranchAddress("nsample", nsample_.data(), &b_nsample_);
+  tree_->SetBranchAddress("offset", offset_.data(), &b_offset_);
+  if (packed_) {
+    pkoffset_.resize(n);
+    tree_->SetBranchAddress("pkoffset", pkoffset_.data(), &b_pkoffset_);
+  }
+  if (cropped_) {
+    tree_->SetBranchAddress("crop_start", crop_start_.data(), &b_crop_start_);
+  }
+}
+
+void WftreeReader::reserveSamples(int nwf) {
+  if (nwf <= static_cast<int>(wf_.size())) {
+    return;
+  }
+  wf_.resize(std::max(static_cast<size_t>(nwf), 2 * wf_.size()));
+  if (!packed_) {
+    tree_->SetBranchAddress("wf", wf_.data(), &b_wf_);
+  }
+}
+
+void WftreeReader::reservePacked(int nbytes) {
+  if (nbytes <= static_cast<int>(wfpk_.size())) {
+    return;
+  }
+  wfpk_.resize(std::max(static_cast<size_t>(nbytes), 2 * wfpk_.size()));
+  tree_->SetBranchAddress("wfpk", wfpk_.data(), &b_wfpk_);
+}
+
+void WftreeReader::updateChannels(bool with_samples) {
+  channels_.resize(nch_);
+  for (int i = 0; i < nch_; i++) {
+    WftreeChannel &c = channels_[i];
+    c.det = det_[i];
+    c.ch = ch_[i];
+    c.nsample = nsample_[i];
+    c.crop_start = crop_start_[i];
+    const bool in_buffer = offset_[i] >= 0 && nsample_[i] >= 0 &&
+                           static_cast<size_t>(offset_[i]) + nsample_[i] <= wf_.size();
+    c.wf = (with_samples && in_buffer) ? wf_.data() + offset_[i] : nullptr;
+  }
+}
+
+// Decode wfpk into wf_ at the sample offsets of each channel
+void WftreeReader::decodePacked(Long64_t entry) {
+  for (int i = 0; i < nch_; i++) {
+    const int begin = pkoffset_[i];
+    const int end = (i + 1 < nch_) ? pkoffset_[i + 1] : nwfpk_;
+    const bool in_buffer = offset_[i] >= 0 && nsample_[i] >= 0 &&
+                           static_cast<size_t>(offset_[i]) + nsample_[i] <= wf_.size();
+    if (!in_buffer) {
+      continue;
+    }
+    short *wf = wf_.data() + offset_[i];
+    if (begin < 0 || end < begin || end > nwfpk_ ||
+        !decodeWaveform(wfpk_.data() + begin, static_cast<size_t>(end - begin), nsample_[i], wf)) {
+      std::cerr << "Warning: Corrupt wfpk data at entry " << entry << " (det " << det_[i] << " ch "
+                << ch_[i] << "), samples set to 0\n";
+      std::fill(wf, wf + nsample_[i], 0);
+    }
+  }
+}
+
+int WftreeReader::readEvtn(Long64_t entry) {
+  b_evtn_->GetEntry(entry);
+  return evtn_;
+}
+
+int WftreeReader::readHeaders(Long64_t entry) {
+  b_evtn_->GetEntry(entry);
+  if (layout_ == WftreeLayout::Event) {
+    b_nch_->GetEntry(entry);
+    reserveChannels(nch_);
+    b_offset_->GetEntry(entry);
+  }
+  b_det_->GetEntry(entry);
+  b_ch_->GetEntry(entry);
+  b_nsample_->GetEntry(entry);
+  if (cropped_) {
+    b_crop_start_->GetEntry(entry);
+  }
+  updateChannels(false);
+  loaded_entry_ = -1;
+  return nch_;
+}
+
+int WftreeReader::load(Long64_t entry) {
+  if (entry == loaded_entry_) {
+    return nch_;
+  }
+  readHeaders(entry);
+  if (layout_ == WftreeLayout::Event) {
+    b_nwf_->GetEntry(entry);
+    reserveSamples(nwf_);
+  } else if (packed_) {
+    reserveSamples(nsample_[0]);
+  }
+  if (packed_) {
+    if (layout_ == WftreeLayout::Event) {
+      b_pkoffset_->GetEntry(entry);
+    }
+    b_nwfpk_->GetEntry(entry);
+    reservePacked(nwfpk_);
+    b_wfpk_->GetEntry(entry);
+    decodePacked(entry);
+  } else {
+    b_wf_->GetEntry(entry);
+  }
+  updateChannels(true);
+  loaded_entry_ = entry;
+  return nch_;
+}
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstdlib>
 #include <getopt.h>
@@ -7,6 +8,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <vector>
 
@@ -21,7 +23,10 @@
 #include <TMarker.h>
 #include <TTree.h>
 
+#include "AnalysisTree.h"
 #include "WaveformAnalysis.h"
+#include "WaveformKernels.h"
+#include "WftreeReader.h"
 
 namespace {
 
@@ -31,6 +36,10 @@ constexpr int EXIT_FILE_ERROR = 2;
 constexpr int EXIT_TREE_ERROR = 3;
 constexpr int EXIT_CONFIG_ERROR = 4;
 
+// --threads: waveforms analyzed per window, and per worker claim within it
+constexpr size_t kAnalysisWindow = 16384;
+constexpr size_t kAnalysisChunk = 64;
+
 struct EntryKey {
   int evtn = 0;
   int det = 0;
@@ -41,6 +50,63 @@ struct EntryKey {
   }
 };
 
+// tree entry and channel index within the entry (always 0 for the channel layout)
+struct EntryLocation {
+  Long64_t entry = 0;
+  int index = 0;
+};
+
+// --stream: waveform of the current event, samples copied to a shared buffer
+struct StreamedWaveform {
+  EntryKey key;
+  int nsample = 0;
+  int crop_start = 0;
+  size_t offset = 0;
+};
+
+// --threads: one waveform of the current window; result is set by the
+// worker that claims it
+struct AnalysisJob {
+  EntryKey key;
+  int nsample = 0;
+  int crop_start = 0;
+  size_t offset = 0;
+  WaveformAnalysisResult result;
+};
+
+// Analyze all jobs of a window on nthreads threads. Workers claim chunks of
+// consecutive jobs from a shared counter, so slow chunks do not hold up the
+// others; each result goes to its own job slot and each worker has its own
+// scratch buffers.
+void analyzeWindow(std::vector<AnalysisJob> &jobs, const std::vector<short> &samples,
+                   const AnalysisParamTable &table, int nthreads) {
+  std::atomic<size_t> next(0);
+  auto work = [&]() {
+    WaveformScratch scratch;
+    for (;;) {
+      const size_t begin = next.fetch_add(kAnalysisChunk);
+      if (begin >= jobs.size()) {
+        return;
+      }
+      const size_t end = std::min(begin + kAnalysisChunk, jobs.size());
+      for (size_t j = begin; j < end; j++) {
+        AnalysisJob &job = jobs[j];
+        job.result = analyzeWaveform(samples.data() + job.offset, job.nsample,
+                                     table.compiled(job.key.det, job.key.ch), scratch);
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (int t = 1; t < nthreads; t++) {
+    workers.emplace_back(work);
+  }
+  work();
+  for (std::thread &w : workers) {
+    w.join();
+  }
+}
+
 void print_usage(const char *progname) {
   std::cout << "Usage: " << progname << " <input.root> [OPTIONS]\n"
             << "Options:\n"
@@ -49,7 +115,10 @@ void print_usage(const char *progname) {
             << "  --generate-template     Generate template config and exit\n"
             << "  -w, --save-waveform     Save baseline-corrected waveform as TGraph\n"
             << "  -n, --maxevt N          Max events to process by unique evtn (-1 = all)\n"
+            << "  --stream                Single sequential pass for converter-ordered files\n"
+            << "                          (events in file order, --maxevt = first N events)\n"
             << "  -b, --batch             Run in batch mode (disable ROOT GUI)\n"
+            << "  -j, --threads N         Analyze on N threads (output order unchanged)\n"
             << "  -h, --help              Show this help\n";
 }
 
@@ -83,7 +152,8 @@ bool hasThreeSigmaSignal(const short *wf, int nsample, float baseline, float bas
   return false;
 }
 
-TCanvas *buildWaveformCanvas(const short *wf, int nsample, const ResolvedAnalysisParams &params,
+// first_sample: position of wf[0] in the original trace (cropped waveforms)
+TCanvas *buildWaveformCanvas(const short *wf, int nsample, int first_sample, const ResolvedAnalysisParams &params,
                              const WaveformAnalysisResult &result, const std::string &name,
                              const std::string &title) {
   TCanvas *c = new TCanvas(name.c_str(), title.c_str(), 1100, 700);
@@ -95,7 +165,7 @@ TCanvas *buildWaveformCanvas(const short *wf, int nsample, const ResolvedAnalysi
   double ymin = std::numeric_limits<double>::max();
   double ymax = std::numeric_limits<double>::lowest();
   for (int i = 0; i < nsample; i++) {
-    const double x = static_cast<double>(i) * params.sample_rate_ns;
+    const double x = static_cast<double>(first_sample + i) * params.sample_rate_ns;
     const double y = static_cast<double>(wf[i]);
     ymin = std::min(ymin, y);
     ymax = std::max(ymax, y);
@@ -118,8 +188,8 @@ TCanvas *buildWaveformCanvas(const short *wf, int nsample, const ResolvedAnalysi
   legend->SetFillStyle(0);
   legend->AddEntry(g, "Raw waveform", "l");
 
-  TLine *baseline_line = new TLine(0.0, result.baseline,
-                                   static_cast<double>(nsample - 1) * params.sample_rate_ns,
+  TLine *baseline_line = new TLine(static_cast<double>(first_sample) * params.sample_rate_ns, result.baseline,
+                                   static_cast<double>(first_sample + nsample - 1) * params.sample_rate_ns,
                                    result.baseline);
   baseline_line->SetLineColor(kBlue + 2);
   baseline_line->SetLineStyle(2);
@@ -181,7 +251,9 @@ int main(int argc, char *argv[]) {
   bool generate_template = false;
   bool save_waveform = false;
   bool batch_mode = false;
+  bool stream_mode = false;
   int maxevt = -1;
+  int nthreads = 1;
 
   static struct option long_options[] = {{"output", required_argument, 0, 'o'},
                                           {"config", required_argument, 0, 'c'},
@@ -189,12 +261,14 @@ int main(int argc, char *argv[]) {
                                           {"save-waveform", no_argument, 0, 'w'},
                                           {"maxevt", required_argument, 0, 'n'},
                                           {"batch", no_argument, 0, 'b'},
+                                          {"stream", no_argument, 0, 's'},
+                                          {"threads", required_argument, 0, 'j'},
                                           {"help", no_argument, 0, 'h'},
                                           {0, 0, 0, 0}};
 
   int opt = 0;
   int option_index = 0;
-  while ((opt = getopt_long(argc, argv, "o:c:wn:bh", long_options, &option_index)) != -1) {
+  while ((opt = getopt_long(argc, argv, "o:c:wn:bj:h", long_options, &option_index)) != -1) {
     switch (opt) {
     case 'o':
       outfile = optarg;
@@ -214,6 +288,12 @@ int main(int argc, char *argv[]) {
     case 'b':
       batch_mode = true;
       break;
+    case 's':
+      stream_mode = true;
+      break;
+    case 'j':
+      nthreads = std::atoi(optarg);
+      break;
     case 'h':
       print_usage(argv[0]);
       return EXIT_OK;
@@ -226,6 +306,10 @@ int main(int argc, char *argv[]) {
   if (batch_mode) {
     gROOT->SetBatch(kTRUE);
   }
+  if (nthreads < 1) {
+    std::cerr << "Warning: --threads must be at least 1; using 1.\n";
+    nthreads = 1;
+  }
 
   if (generate_template) {
     const std::string template_path =
@@ -254,6 +338,8 @@ int main(int argc, char *argv[]) {
       return EXIT_CONFIG_ERROR;
     }
   }
+  AnalysisParamTable params_table;
+  params_table.compile(config);
 
   TFile *fin = TFile::Open(infile.c_str(), "READ");
   if (!fin || fin->IsZombie()) {
@@ -268,52 +354,15 @@ int main(int argc, char *argv[]) {
     return EXIT_TREE_ERROR;
   }
 
-  Int_t evtn = 0, det = 0, ch = 0, nsample = 0;
-  Short_t wf[4096];
-  tree->SetBranchAddress("evtn", &evtn);
-  tree->SetBranchAddress("det", &det);
-  tree->SetBranchAddress("ch", &ch);
-  tree->SetBranchAddress("nsample", &nsample);
-  tree->SetBranchAddress("wf", wf);
-
-  const Long64_t nentries = tree->GetEntries();
-
-  std::set<int> unique_evtn_set;
-  for (Long64_t i = 0; i < nentries; i++) {
-    tree->GetEntry(i);
-    unique_evtn_set.insert(evtn);
+  WftreeReader reader;
+  std::string reader_err;
+  if (!reader.open(tree, &reader_err)) {
+    std::cerr << "Error: " << reader_err << " in " << infile << "\n";
+    fin->Close();
+    return EXIT_TREE_ERROR;
   }
 
-  std::vector<int> selected_evtn(unique_evtn_set.begin(), unique_evtn_set.end());
-  std::sort(selected_evtn.begin(), selected_evtn.end());
-  if (maxevt > 0 && static_cast<int>(selected_evtn.size()) > maxevt) {
-    selected_evtn.resize(maxevt);
-  }
-  const std::set<int> selected_evtn_set(selected_evtn.begin(), selected_evtn.end());
-
-  std::map<EntryKey, Long64_t> entry_map;
-  int skipped_nsample = 0;
-  int skipped_ch_out_of_range = 0;
-  int duplicate_entries = 0;
-  for (Long64_t i = 0; i < nentries; i++) {
-    tree->GetEntry(i);
-    if (selected_evtn_set.find(evtn) == selected_evtn_set.end()) {
-      continue;
-    }
-    if (nsample <= 0 || nsample > 4096) {
-      skipped_nsample++;
-      continue;
-    }
-    if (ch < 0 || ch > 7) {
-      skipped_ch_out_of_range++;
-      continue;
-    }
-    EntryKey key{evtn, det, ch};
-    if (entry_map.find(key) != entry_map.end()) {
-      duplicate_entries++;
-    }
-    entry_map[key] = i; // last-wins
-  }
+  const Long64_t nentries = reader.entries();
 
   TFile *fout = new TFile(outfile.c_str(), "RECREATE");
   if (!fout || fout->IsZombie()) {
@@ -322,108 +371,25 @@ int main(int argc, char *argv[]) {
     return EXIT_FILE_ERROR;
   }
 
-  TTree *analysis_tree = new TTree("analysis_tree", "Waveform analysis results");
-
-  Int_t out_evtn = 0, out_det = 0, out_ch = 0, out_nsample = 0;
-  Float_t out_baseline = 0.0f, out_baseline_rms = 0.0f, out_amplitude = 0.0f;
-  Int_t out_peak_sample = -1;
-  Float_t out_peak_time_ns = -1.0f;
-  Float_t out_cfd_time_ns = -1.0f;
-  Float_t out_cfd10 = -1.0f, out_cfd20 = -1.0f, out_cfd30 = -1.0f, out_cfd40 = -1.0f, out_cfd50 = -1.0f;
-  Float_t out_cfd60 = -1.0f, out_cfd70 = -1.0f, out_cfd80 = -1.0f, out_cfd90 = -1.0f;
-  Float_t out_dcfd_time_ns = -1.0f;
-  Float_t out_dcfd10 = -1.0f, out_dcfd20 = -1.0f, out_dcfd30 = -1.0f, out_dcfd40 = -1.0f,
-          out_dcfd50 = -1.0f;
-  Float_t out_dcfd60 = -1.0f, out_dcfd70 = -1.0f, out_dcfd80 = -1.0f, out_dcfd90 = -1.0f;
-  Float_t out_risetime = 0.0f;
-  Bool_t out_valid = false;
-
-  analysis_tree->Branch("evtn", &out_evtn, "evtn/I");
-  analysis_tree->Branch("det", &out_det, "det/I");
-  analysis_tree->Branch("ch", &out_ch, "ch/I");
-  analysis_tree->Branch("nsample", &out_nsample, "nsample/I");
-  analysis_tree->Branch("baseline", &out_baseline, "baseline/F");
-  analysis_tree->Branch("baseline_rms", &out_baseline_rms, "baseline_rms/F");
-  analysis_tree->Branch("amplitude", &out_amplitude, "amplitude/F");
-  analysis_tree->Branch("peak_sample", &out_peak_sample, "peak_sample/I");
-  analysis_tree->Branch("peak_time_ns", &out_peak_time_ns, "peak_time_ns/F");
-  analysis_tree->Branch("cfd_time_ns", &out_cfd_time_ns, "cfd_time_ns/F");
-  analysis_tree->Branch("cfd10", &out_cfd10, "cfd10/F");
-  analysis_tree->Branch("cfd20", &out_cfd20, "cfd20/F");
-  analysis_tree->Branch("cfd30", &out_cfd30, "cfd30/F");
-  analysis_tree->Branch("cfd40", &out_cfd40, "cfd40/F");
-  analysis_tree->Branch("cfd50", &out_cfd50, "cfd50/F");
-  analysis_tree->Branch("cfd60", &out_cfd60, "cfd60/F");
-  analysis_tree->Branch("cfd70", &out_cfd70, "cfd70/F");
-  analysis_tree->Branch("cfd80", &out_cfd80, "cfd80/F");
-  analysis_tree->Branch("cfd90", &out_cfd90, "cfd90/F");
-  analysis_tree->Branch("dcfd_time_ns", &out_dcfd_time_ns, "dcfd_time_ns/F");
-  analysis_tree->Branch("dcfd10", &out_dcfd10, "dcfd10/F");
-  analysis_tree->Branch("dcfd20", &out_dcfd20, "dcfd20/F");
-  analysis_tree->Branch("dcfd30", &out_dcfd30, "dcfd30/F");
-  analysis_tree->Branch("dcfd40", &out_dcfd40, "dcfd40/F");
-  analysis_tree->Branch("dcfd50", &out_dcfd50, "dcfd50/F");
-  analysis_tree->Branch("dcfd60", &out_dcfd60, "dcfd60/F");
-  analysis_tree->Branch("dcfd70", &out_dcfd70, "dcfd70/F");
-  analysis_tree->Branch("dcfd80", &out_dcfd80, "dcfd80/F");
-  analysis_tree->Branch("dcfd90", &out_dcfd90, "dcfd90/F");
-  analysis_tree->Branch("risetime", &out_risetime, "risetime/F");
-  analysis_tree->Branch("valid", &out_valid, "valid/O");
+  AnalysisTreeOutput analysis_out;
+  createAnalysisTree(analysis_out);
 
   int analyzed_count = 0;
   int invalid_count = 0;
   int disabled_count = 0;
   int saved_canvases = 0;
-  int processed_unique_events = 0;
-  int last_evtn = std::numeric_limits<int>::min();
-
-  for (const auto &kv : entry_map) {
-    tree->GetEntry(kv.second);
-    const EntryKey &key = kv.first;
-    if (key.evtn != last_evtn) {
-      last_evtn = key.evtn;
-      processed_unique_events++;
-      if ((processed_unique_events % 1000) == 0) {
-        std::cout << "Processing event " << processed_unique_events
-                  << " / " << selected_evtn.size()
-                  << " (evtn=" << key.evtn << ")" << std::endl;
-      }
-    }
-    const ResolvedAnalysisParams params = resolveAnalysisParams(config, key.det, key.ch);
-    const WaveformAnalysisResult result = analyzeWaveform(wf, nsample, params);
-
-    out_evtn = key.evtn;
-    out_det = key.det;
-    out_ch = key.ch;
-    out_nsample = nsample;
-    out_baseline = result.baseline;
-    out_baseline_rms = result.baseline_rms;
-    out_amplitude = result.amplitude;
-    out_peak_sample = result.peak_sample;
-    out_peak_time_ns = result.peak_time_ns;
-    out_cfd_time_ns = result.cfd_time_ns;
-    out_cfd10 = result.cfd_times[0];
-    out_cfd20 = result.cfd_times[1];
-    out_cfd30 = result.cfd_times[2];
-    out_cfd40 = result.cfd_times[3];
-    out_cfd50 = result.cfd_times[4];
-    out_cfd60 = result.cfd_times[5];
-    out_cfd70 = result.cfd_times[6];
-    out_cfd80 = result.cfd_times[7];
-    out_cfd90 = result.cfd_times[8];
-    out_dcfd_time_ns = result.dcfd_time_ns;
-    out_dcfd10 = result.dcfd_times[0];
-    out_dcfd20 = result.dcfd_times[1];
-    out_dcfd30 = result.dcfd_times[2];
-    out_dcfd40 = result.dcfd_times[3];
-    out_dcfd50 = result.dcfd_times[4];
-    out_dcfd60 = result.dcfd_times[5];
-    out_dcfd70 = result.dcfd_times[6];
-    out_dcfd80 = result.dcfd_times[7];
-    out_dcfd90 = result.dcfd_times[8];
-    out_risetime = result.risetime;
-    out_valid = result.valid;
-    analysis_tree->Fill();
+  int skipped_nsample = 0;
+  int skipped_ch_out_of_range = 0;
+  int duplicate_entries = 0;
+
+  // Everything after the analysis runs on this thread, in input order
+  auto fillEntry = [&](const EntryKey &key, const short *wf, int nsample, int crop_start,
+                       WaveformAnalysisResult &result) {
+    const ResolvedAnalysisParams &params = params_table.resolved(key.det, key.ch);
+    // times of cropped waveforms (--suppress) refer to the original trace
+    shiftAnalysisResult(result, crop_start, params);
+
+    fillAnalysisTree(analysis_out, key.evtn, key.det, key.ch, nsample, result);
 
     analyzed_count++;
     if (!params.enabled) {
@@ -440,21 +406,190 @@ int main(int argc, char *argv[]) {
           Form("Evt %d Det %d Ch %d | amp=%.2f cfd%d=%.2fns valid=%d", key.evtn, key.det, key.ch,
                result.amplitude, params.cfd_target_percent, result.cfd_time_ns,
                static_cast<int>(result.valid));
-      TCanvas *c = buildWaveformCanvas(wf, nsample, params, result, cname, ctitle);
+      TCanvas *c = buildWaveformCanvas(wf, nsample, crop_start, params, result, cname, ctitle);
       c->Write();
       saved_canvases++;
       delete c;
     }
+  };
+
+  WaveformScratch scratch; // single-threaded analysis
+  std::vector<AnalysisJob> window_jobs;
+  std::vector<short> window_samples;
+  auto flushWindow = [&]() {
+    analyzeWindow(window_jobs, window_samples, params_table, nthreads);
+    for (AnalysisJob &job : window_jobs) {
+      fillEntry(job.key, window_samples.data() + job.offset, job.nsample, job.crop_start, job.result);
+    }
+    window_jobs.clear();
+    window_samples.clear();
+  };
+
+  auto analyzeEntry = [&](const EntryKey &key, const short *wf, int nsample, int crop_start) {
+    if (nthreads == 1) {
+      WaveformAnalysisResult result = analyzeWaveform(wf, nsample, params_table.compiled(key.det, key.ch), scratch);
+      fillEntry(key, wf, nsample, crop_start, result);
+      return;
+    }
+    AnalysisJob job;
+    job.key = key;
+    job.nsample = nsample;
+    job.crop_start = crop_start;
+    job.offset = window_samples.size();
+    window_jobs.push_back(job);
+    window_samples.insert(window_samples.end(), wf, wf + nsample);
+    if (window_jobs.size() >= kAnalysisWindow) {
+      flushWindow();
+    }
+  };
+
+  int selected_events = 0;
+  Long64_t scanned_entries = nentries;
+  int out_of_order_events = 0;
+
+  if (stream_mode) {
+    // One sequential pass. Consecutive entries with the same evtn form an
+    // event; its waveforms are analyzed in (det,ch) order when the next
+    // event starts, duplicates last-wins, so a converter-ordered file gives
+    // the same analysis_tree as the default mode.
+    std::vector<StreamedWaveform> pending;
+    std::vector<short> pending_samples;
+    auto flushEvent = [&]() {
+      std::stable_sort(pending.begin(), pending.end(), [](const StreamedWaveform &a, const StreamedWaveform &b) {
+        return std::tie(a.key.det, a.key.ch) < std::tie(b.key.det, b.key.ch);
+      });
+      for (size_t k = 0; k < pending.size(); k++) {
+        const StreamedWaveform &w = pending[k];
+        if (k + 1 < pending.size() && pending[k + 1].key.det == w.key.det && pending[k + 1].key.ch == w.key.ch) {
+          duplicate_entries++;
+          continue;
+        }
+        analyzeEntry(w.key, pending_samples.data() + w.offset, w.nsample, w.crop_start);
+      }
+      pending.clear();
+      pending_samples.clear();
+    };
+
+    bool in_event = false;
+    int current_evtn = 0;
+    int max_evtn = std::numeric_limits<int>::min();
+    scanned_entries = 0;
+    for (Long64_t i = 0; i < nentries; i++) {
+      const int evtn = reader.readEvtn(i);
+      if (!in_event || evtn != current_evtn) {
+        if (in_event) {
+          flushEvent();
+          in_event = false;
+        }
+        if (selected_events == 0 || evtn > max_evtn) {
+          if (maxevt > 0 && selected_events >= maxevt) {
+            break;
+          }
+          selected_events++;
+          max_evtn = evtn;
+          if ((selected_events % 1000) == 0) {
+            std::cout << "Processing event " << selected_events << " (evtn=" << evtn << ")" << std::endl;
+          }
+        } else {
+          // evtn seen before (or lower): analyzed as a separate event
+          out_of_order_events++;
+        }
+        current_evtn = evtn;
+        in_event = true;
+      }
+
+      scanned_entries++;
+      const int nch = reader.load(i);
+      for (int k = 0; k < nch; k++) {
+        const WftreeChannel &c = reader.channel(k);
+        if (c.nsample <= 0 || c.nsample > reader.maxSamples() || c.wf == nullptr) {
+          skipped_nsample++;
+          continue;
+        }
+        if (c.ch < 0 || c.ch > 7) {
+          skipped_ch_out_of_range++;
+          continue;
+        }
+        pending.push_back(StreamedWaveform{EntryKey{evtn, c.det, c.ch}, c.nsample, c.crop_start,
+                                           pending_samples.size()});
+        pending_samples.insert(pending_samples.end(), c.wf, c.wf + c.nsample);
+      }
+    }
+    if (in_event) {
+      flushEvent();
+    }
+    if (out_of_order_events > 0) {
+      std::cerr << "Warning: " << out_of_order_events
+                << " events not in evtn order; --stream analyzed them in file order\n";
+    }
+  } else {
+    std::set<int> unique_evtn_set;
+    for (Long64_t i = 0; i < nentries; i++) {
+      unique_evtn_set.insert(reader.readEvtn(i));
+    }
+
+    std::vector<int> selected_evtn(unique_evtn_set.begin(), unique_evtn_set.end());
+    std::sort(selected_evtn.begin(), selected_evtn.end());
+    if (maxevt > 0 && static_cast<int>(selected_evtn.size()) > maxevt) {
+      selected_evtn.resize(maxevt);
+    }
+    const std::set<int> selected_evtn_set(selected_evtn.begin(), selected_evtn.end());
+    selected_events = static_cast<int>(selected_evtn.size());
+
+    std::map<EntryKey, EntryLocation> entry_map;
+    for (Long64_t i = 0; i < nentries; i++) {
+      if (selected_evtn_set.find(reader.readEvtn(i)) == selected_evtn_set.end()) {
+        continue;
+      }
+      const int nch = reader.readHeaders(i);
+      for (int k = 0; k < nch; k++) {
+        const WftreeChannel &c = reader.channel(k);
+        if (c.nsample <= 0 || c.nsample > reader.maxSamples()) {
+          skipped_nsample++;
+          continue;
+        }
+        if (c.ch < 0 || c.ch > 7) {
+          skipped_ch_out_of_range++;
+          continue;
+        }
+        EntryKey key{reader.evtn(), c.det, c.ch};
+        if (entry_map.find(key) != entry_map.end()) {
+          duplicate_entries++;
+        }
+        entry_map[key] = EntryLocation{i, k}; // last-wins
+      }
+    }
+
+    int processed_unique_events = 0;
+    int last_evtn = std::numeric_limits<int>::min();
+    for (const auto &kv : entry_map) {
+      reader.load(kv.second.entry);
+      const WftreeChannel &wfch = reader.channel(kv.second.index);
+      const EntryKey &key = kv.first;
+      if (key.evtn != last_evtn) {
+        last_evtn = key.evtn;
+        processed_unique_events++;
+        if ((processed_unique_events % 1000) == 0) {
+          std::cout << "Processing event " << processed_unique_events
+                    << " / " << selected_evtn.size()
+                    << " (evtn=" << key.evtn << ")" << std::endl;
+        }
+      }
+      analyzeEntry(key, wfch.wf, wfch.nsample, wfch.crop_start);
+    }
   }
+  flushWindow();
 
   fout->cd();
-  analysis_tree->Write();
+  analysis_out.tree->Write();
   fout->Close();
   fin->Close();
 
   std::cout << "\nSummary:\n"
-            << "  Unique events selected: " << selected_evtn.size() << "\n"
-            << "  Input entries scanned: " << nentries << "\n"
+            << "  Unique events selected: " << selected_events << "\n"
+            << "  Input entries scanned: " << scanned_entries
+            << (reader.layout() == WftreeLayout::Event ? " (event layout)" : " (channel layout)")
+            << (stream_mode ? ", one pass\n" : "\n")
             << "  Unique (evtn,det,ch) analyzed: " << analyzed_count << "\n"
             << "  Duplicate entries overwritten (last-wins): " << duplicate_entries << "\n"
             << "  Entries skipped (invalid nsample): " << skipped_nsample << "\n"
@@ -462,6 +597,7 @@ int main(int argc, char *argv[]) {
             << "  Disabled by config: " << disabled_count << "\n"
             << "  Invalid analysis results: " << invalid_count << "\n"
             << "  Saved waveform canvases: " << saved_canvases << "\n"
+            << "  Analysis kernels: " << waveformKernelsImpl() << "\n"
             << "Output written to: " << outfile << "\n";
 
   delete fin;
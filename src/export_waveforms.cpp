@@ -18,6 +18,8 @@
 #include <TSystem.h>
 #include <TTree.h>
 
+#include "WftreeReader.h"
+
 // Exit codes
 constexpr int EXIT_OK = 0;
 constexpr int EXIT_CLI_ERROR = 1;
@@ -39,12 +41,13 @@ void createDirIfNotExists(const std::string &path) {
   gSystem->mkdir(path.c_str(), kTRUE);
 }
 
-TGraph *makeGraph(Short_t *wf, Int_t nsample, const char *name, const char *title) {
+// first_sample: sample number of wf[0] (crop_start of cropped waveforms)
+TGraph *makeGraph(const Short_t *wf, Int_t nsample, Int_t first_sample, const char *name, const char *title) {
   TGraph *g = new TGraph(nsample);
   g->SetName(name);
   g->SetTitle(title);
   for (int i = 0; i < nsample; i++) {
-    g->SetPoint(i, i, wf[i]);
+    g->SetPoint(i, first_sample + i, wf[i]);
   }
   g->GetXaxis()->SetTitle("Sample");
   g->GetYaxis()->SetTitle("ADC");
@@ -149,16 +152,16 @@ int main(int argc, char *argv[]) {
     return EXIT_TREE_ERROR;
   }
 
-  // Setup branches
-  Int_t evtn, det, ch, nsample;
-  Short_t wf[4096];
-  tree->SetBranchAddress("evtn", &evtn);
-  tree->SetBranchAddress("det", &det);
-  tree->SetBranchAddress("ch", &ch);
-  tree->SetBranchAddress("nsample", &nsample);
-  tree->SetBranchAddress("wf", wf);
+  // Setup branches (channel or event layout)
+  WftreeReader reader;
+  std::string reader_err;
+  if (!reader.open(tree, &reader_err)) {
+    std::cerr << "Error: " << reader_err << " in " << infile << "\n";
+    fin->Close();
+    return EXIT_TREE_ERROR;
+  }
 
-  Long64_t nentries = tree->GetEntries();
+  Long64_t nentries = reader.entries();
 
   // Statistics
   int skipped_nsample = 0;
@@ -170,8 +173,7 @@ int main(int argc, char *argv[]) {
   // Pass 1: Collect unique evtn values and build eventMap
   std::set<int> unique_evtn_set;
   for (Long64_t i = 0; i < nentries; i++) {
-    tree->GetEntry(i);
-    unique_evtn_set.insert(evtn);
+    unique_evtn_set.insert(reader.readEvtn(i));
   }
 
   // Sort and limit evtn values
@@ -182,31 +184,35 @@ int main(int argc, char *argv[]) {
   }
   std::set<int> selected_evtn_set(selected_evtn.begin(), selected_evtn.end());
 
-  // Build eventMap: (evtn, det, ch) -> vector of entry indices
+  // Build eventMap: (evtn, det, ch) -> vector of (entry, channel index in entry)
   using Key = std::tuple<int, int, int>;
-  std::map<Key, std::vector<Long64_t>> eventMap;
+  using Location = std::pair<Long64_t, int>;
+  std::map<Key, std::vector<Location>> eventMap;
 
   for (Long64_t i = 0; i < nentries; i++) {
-    tree->GetEntry(i);
-
     // Skip if not in selected events
-    if (selected_evtn_set.find(evtn) == selected_evtn_set.end()) {
+    if (selected_evtn_set.find(reader.readEvtn(i)) == selected_evtn_set.end()) {
       continue;
     }
 
-    // Validate nsample
-    if (nsample <= 0 || nsample > 4096) {
-      std::cerr << "Warning: Invalid nsample=" << nsample << " at entry " << i << ", skipping\n";
-      skipped_nsample++;
-      continue;
-    }
-    if (ch < 0 || ch > 7) {
-      skipped_ch_out_of_range++;
-      continue;
-    }
+    const int nch = reader.readHeaders(i);
+    for (int k = 0; k < nch; k++) {
+      const WftreeChannel &wfch = reader.channel(k);
+
+      // Validate nsample
+      if (wfch.nsample <= 0 || wfch.nsample > reader.maxSamples()) {
+        std::cerr << "Warning: Invalid nsample=" << wfch.nsample << " at entry " << i << ", skipping\n";
+        skipped_nsample++;
+        continue;
+      }
+      if (wfch.ch < 0 || wfch.ch > 7) {
+        skipped_ch_out_of_range++;
+        continue;
+      }
 
-    Key key = std::make_tuple(evtn, det, ch);
-    eventMap[key].push_back(i);
+      Key key = std::make_tuple(reader.evtn(), wfch.det, wfch.ch);
+      eventMap[key].push_back(std::make_pair(i, k));
+    }
   }
 
   // Count duplicates
@@ -274,13 +280,14 @@ int main(int argc, char *argv[]) {
       Key key = std::make_tuple(evt, d, c);
       auto it = eventMap.find(key);
 
-      const std::vector<Long64_t> &entries = it->second;
-      tree->GetEntry(entries.front());
+      const std::vector<Location> &entries = it->second;
+      reader.load(entries.front().first);
+      const WftreeChannel &wfch = reader.channel(entries.front().second);
 
       std::string gname = Form("wf_evt%04d_det%02d_ch%02d", evt, d, c);
       std::string gtitle = Form("Event %d Det %d Ch %d", evt, d, c);
 
-      TGraph *g = makeGraph(wf, nsample, gname.c_str(), gtitle.c_str());
+      TGraph *g = makeGraph(wfch.wf, wfch.nsample, wfch.crop_start, gname.c_str(), gtitle.c_str());
       targetDir->cd();
       g->Write();
       total_tgraphs++;
@@ -331,7 +338,8 @@ int main(int argc, char *argv[]) {
   // Print summary
   std::cout << "\nSummary:\n"
             << "  Events processed: " << selected_evtn.size() << " (unique evtn values)\n"
-            << "  TTree entries scanned: " << nentries << "\n"
+            << "  TTree entries scanned: " << nentries
+            << (reader.layout() == WftreeLayout::Event ? " (event layout)" : " (channel layout)") << "\n"
             << "  Entries skipped (invalid nsample): " << skipped_nsample << "\n"
             << "  Entries skipped (ch outside 0-7): " << skipped_ch_out_of_range << "\n"
             << "  Unique (evt,det,ch) keys: " << unique_keys << "\n"
@@ -3,35 +3,71 @@
 #include <cstdlib>
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <condition_variable>
 #include <csignal>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <functional>
 #include <getopt.h>
 #include <cmath>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <poll.h>
 #include <set>
 #include <string>
+#include <thread>
 #include <unistd.h>
 #include <vector>
 
+#include <Compression.h>
 #include <TApplication.h>
 #include <TCanvas.h>
 #include <TFile.h>
 #include <TH1.h>
 #include <TLatex.h>
+#include <TMemFile.h>
 #include <TPad.h>
 #include <TROOT.h>
 #include <TSystem.h>
 #include <TTree.h>
 
+#include "AnalysisTree.h"
+#include "C16Unpack.h"
 #include "RIDFParser.h"
+#include "SPSCQueue.h"
+#include "WaveformAnalysis.h"
+#include "WaveformCodec.h"
+#include "WaveformKernels.h"
 
 // SIGINT 핸들러 (온라인 모드 graceful shutdown)
 static volatile sig_atomic_t g_stop_requested = 0;
+static int g_sigint_pipe[2] = {-1, -1};  // self-pipe: wakes the online wait on SIGINT
 
 void sigint_handler(int sig) {
   (void)sig;
   g_stop_requested = 1;
+  if (g_sigint_pipe[1] >= 0) {
+    const char c = 1;
+    ssize_t n = write(g_sigint_pipe[1], &c, 1);
+    (void)n;
+  }
+}
+
+void install_sigint_handler() {
+  if (pipe(g_sigint_pipe) == 0) {
+    for (int fd : g_sigint_pipe) {
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+      fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+  } else {
+    g_sigint_pipe[0] = g_sigint_pipe[1] = -1;
+  }
+  std::signal(SIGINT, sigint_handler);
 }
 
 void print_usage(const char *progname) {
@@ -41,9 +77,40 @@ void print_usage(const char *progname) {
   std::cout << "  -n, --maxevt N       Maximum events to process (0=unlimited, default: 10000)" << std::endl;
   std::cout << "  -b, --batch          Run in batch mode (no GUI)" << std::endl;
   std::cout << "  -a, --all            Draw all RFSoCs in one monitor canvas (GUI only)" << std::endl;
-  std::cout << "  -l, --online         Online mode (input is hostname/IP)" << std::endl;
+  std::cout << "  -m, --mmap           Memory-map the input file (zero-copy block access)" << std::endl;
+  std::cout << "  -p, --prefetch N     Read N blocks ahead on a background thread (file input, 0=off)" << std::endl;
+  std::cout << "  --first EVTN         Start at the first event with evtn >= EVTN (file input," << std::endl;
+  std::cout << "                       builds/reuses the <input>.ridx event index)" << std::endl;
+  std::cout << "  --last EVTN          Stop after the last event with evtn <= EVTN" << std::endl;
+  std::cout << "  -j, --jobs N         Decode blocks on N worker threads (file input, batch mode)" << std::endl;
+  std::cout << "  -l, --online         Online mode (input is hostname/IP, or host1,host2,... to" << std::endl;
+  std::cout << "                       receive several event builders in one process)" << std::endl;
   std::cout << "                       GUI: auto-advance, type 'q'+Enter to quit" << std::endl;
   std::cout << "                       Batch: use Ctrl+C to stop" << std::endl;
+  std::cout << "  --max-latency MS     Online: longest idle wait between babinfo polls (default: 10)" << std::endl;
+  std::cout << "  --no-pipeline        Online: receive, decode, fill and draw on one thread" << std::endl;
+  std::cout << "  --rate-interval SEC  Online: rate/data-loss report interval (default: 10, 0=off)" << std::endl;
+  std::cout << "  --schema LAYOUT      wftree layout: channel (one entry per det/ch, default)" << std::endl;
+  std::cout << "                       or event (one entry per event, flat sample array)" << std::endl;
+  std::cout << "  --compress ALG[:LVL] Output compression: none, zlib, lz4, zstd or lzma" << std::endl;
+  std::cout << "                       (default level 1/4/5/7; e.g. lz4 online, zstd:5 archival)" << std::endl;
+  std::cout << "  --basket-size BYTES  wftree branch basket size (default: 32000)" << std::endl;
+  std::cout << "  --auto-flush N       wftree auto-flush every N entries (ROOT default: 30 MB)" << std::endl;
+  std::cout << "  --cluster-size MB    wftree auto-flush every MB of uncompressed data" << std::endl;
+  std::cout << "  --threads N          ROOT implicit MT with N threads: wftree baskets are" << std::endl;
+  std::cout << "                       compressed in parallel at each flush (0=off, default)" << std::endl;
+  std::cout << "  --compress-bench N   Fill the first N events with each compression setting" << std::endl;
+  std::cout << "                       in memory, report MB/s and ratio, and exit (file input)" << std::endl;
+  std::cout << "  --pack-waveforms     Store wftree samples delta/bit-packed in wfpk instead of wf" << std::endl;
+  std::cout << "  --analyze CONFIG     Run analyze_waveforms on each stored waveform while converting" << std::endl;
+  std::cout << "                       and write analysis_tree (CONFIG: analyze_waveforms JSON)" << std::endl;
+  std::cout << "  --no-waveforms       With --analyze: do not write wftree" << std::endl;
+  std::cout << "  --suppress CONFIG    Zero suppression / ROI crop before storing (CONFIG: analysis" << std::endl;
+  std::cout << "                       JSON with zero_suppression, zs_nsigma, roi_pre, roi_post)" << std::endl;
+  std::cout << "  --roll-events N      Start a new output part every N shown events" << std::endl;
+  std::cout << "  --roll-size MB       Start a new output part when the current one reaches MB" << std::endl;
+  std::cout << "  --roll-time SEC      Start a new output part every SEC seconds" << std::endl;
+  std::cout << "                       (parts are <output>_partNNN.root, closed in the background)" << std::endl;
   std::cout << "  -h, --help           Show this help message" << std::endl;
 }
 
@@ -61,6 +128,7 @@ struct MonitorState {
   std::map<int, TPad *> all_det_header_pads;
   std::map<int, TPad *> all_det_grid_pads;
   std::map<int, std::array<TPad *, 8>> all_det_channel_pads;
+  bool detach_hists = false;  // output written on another thread (online pipeline, rolled parts)
 };
 
 enum class MonitorLayoutMode {
@@ -68,6 +136,77 @@ enum class MonitorLayoutMode {
   AllDetSingleCanvas = 1
 };
 
+// wftree layout: one entry per (event, det, ch), or one entry per event with
+// per-channel arrays and the samples of all channels in one flat array
+enum class WftreeSchema {
+  Channel = 0,
+  Event = 1
+};
+
+struct AnalyzerOptions {
+  std::string infile;
+  std::string outfile = "rfsoc_ridf_analyzer_out.root";
+  int maxevt = 10000;
+  bool enable_monitor = true;
+  MonitorLayoutMode layout_mode = MonitorLayoutMode::PerDetCanvas;
+  WftreeSchema schema = WftreeSchema::Channel;
+  bool online_mode = false;
+  bool use_mmap = false;
+  int prefetch_blocks = 0;
+  int first_evtn = -1;
+  int last_evtn = -1;
+  int jobs = 1;
+  int max_latency_ms = 10;
+  bool online_pipeline = true;
+  double rate_interval_s = 10.0;
+  std::string compression_spec;  // --compress as given, empty = ROOT default
+  int compression = ROOT::RCompressionSetting::EDefaults::kUseCompiledDefault;
+  int basket_size = 32000;
+  Long64_t auto_flush = 0;  // 0 = ROOT default, >0 entries, <0 bytes
+  int bench_events = 0;
+  int threads = 0;  // ROOT implicit MT pool size, 0 = off
+  bool analyze = false;  // --analyze: fill analysis_tree from the decoded segments
+  AnalysisParamTable analysis_params;
+  bool suppress = false;  // --suppress: zero suppression / ROI crop before storing
+  AnalysisParamTable suppress_params;
+  bool store_waveforms = true;
+  bool pack_waveforms = false;
+  long long roll_events = 0;
+  double roll_size_mb = 0;
+  double roll_time_s = 0;
+};
+
+// "alg[:level]" -> ROOT compression settings (algorithm * 100 + level)
+bool parse_compression(const std::string &spec, int &settings) {
+  const size_t colon = spec.find(':');
+  const std::string alg = spec.substr(0, colon);
+  int level = -1;
+  if (colon != std::string::npos) {
+    level = std::atoi(spec.c_str() + colon + 1);
+    if (level < 0 || level > 9) {
+      return false;
+    }
+  }
+
+  using Alg = ROOT::RCompressionSetting::EAlgorithm;
+  if (alg == "none") {
+    settings = 0;
+    return true;
+  }
+  if (alg == "zlib") {
+    settings = ROOT::CompressionSettings(Alg::kZLIB, level < 0 ? 1 : level);
+  } else if (alg == "lz4") {
+    settings = ROOT::CompressionSettings(Alg::kLZ4, level < 0 ? 4 : level);
+  } else if (alg == "zstd") {
+    settings = ROOT::CompressionSettings(Alg::kZSTD, level < 0 ? 5 : level);
+  } else if (alg == "lzma") {
+    settings = ROOT::CompressionSettings(Alg::kLZMA, level < 0 ? 7 : level);
+  } else {
+    return false;
+  }
+  return true;
+}
+
 void ensure_det_monitor_objects(MonitorState &monitor, int det) {
   if (monitor.det_canvases.find(det) == monitor.det_canvases.end()) {
     TCanvas *canvas = new TCanvas(Form("c_det%d", det), Form("RFSoC %d", det), 1200, 800);
@@ -100,6 +239,9 @@ void fill_det_channel_pad(MonitorState &monitor, int det, int ch, const Detector
     if (hist == nullptr) {
       hist = new TH1S(Form("h_wf_det%d_ch%d", det, ch),
                       Form("RFSoC %d ch %d;Sample;ADC", det, ch), nsample, 0, nsample);
+      if (monitor.detach_hists) {
+        hist->SetDirectory(nullptr);
+      }
     } else if (hist->GetNbinsX() != nsample) {
       hist->SetBins(nsample, 0, nsample);
     }
@@ -312,6 +454,21 @@ bool wait_for_monitor_input(int shown_evt_count, int evtn) {
   return !(line == "q" || line == "Q");
 }
 
+// stdin이 readable일 때 호출: 1='q' 입력, 0=기타 입력, -1=stdin 닫힘
+int read_quit_input() {
+  char buf[16];
+  ssize_t n = read(STDIN_FILENO, buf, sizeof(buf) - 1);
+  if (n == 0) {
+    return -1;
+  }
+  for (ssize_t i = 0; i < n; i++) {
+    if (buf[i] == 'q' || buf[i] == 'Q') {
+      return 1;
+    }
+  }
+  return 0;
+}
+
 // 온라인 GUI 모드용: stdin에서 'q' 입력 체크 (비차단)
 bool check_quit_input() {
   struct pollfd fds[1];
@@ -320,77 +477,737 @@ bool check_quit_input() {
 
   if (poll(fds, 1, 0) > 0) {  // timeout=0: 즉시 반환
     if (fds[0].revents & POLLIN) {
-      char buf[16];
-      ssize_t n = read(STDIN_FILENO, buf, sizeof(buf) - 1);
-      if (n > 0) {
-        buf[n] = '\0';
-        for (ssize_t i = 0; i < n; i++) {
-          if (buf[i] == 'q' || buf[i] == 'Q') {
-            return true;
-          }
-        }
-      }
+      return read_quit_input() > 0;
     }
   }
   return false;
 }
 
-void run_analysis(const std::string &infile, int maxevt, const std::string &outfile,
-                  bool enable_monitor, MonitorLayoutMode layout_mode, bool online_mode) {
-  RIDFParser *p = new RIDFParser();
+// Online idle wait. There is nothing to poll on the babinfo side, so the
+// wait blocks on the SIGINT self-pipe (and stdin in GUI mode) with a timeout
+// that starts at 1 ms after the last data and doubles up to max_latency_ms.
+struct OnlineWaitState {
+  int backoff_ms = 1;
+  int max_latency_ms = 10;
+  bool watch_stdin = false;
+};
+
+enum class OnlineWaitResult {
+  Timeout = 0,
+  Quit = 1,
+  Interrupted = 2
+};
+
+OnlineWaitResult wait_for_online_data(OnlineWaitState &state) {
+  struct pollfd fds[2];
+  int nfds = 0;
+  if (g_sigint_pipe[0] >= 0) {
+    fds[nfds].fd = g_sigint_pipe[0];
+    fds[nfds].events = POLLIN;
+    fds[nfds].revents = 0;
+    nfds++;
+  }
+  const int stdin_slot = nfds;
+  if (state.watch_stdin) {
+    fds[nfds].fd = STDIN_FILENO;
+    fds[nfds].events = POLLIN;
+    fds[nfds].revents = 0;
+    nfds++;
+  }
+
+  const int timeout_ms = state.backoff_ms;
+  state.backoff_ms = std::min(state.backoff_ms * 2, state.max_latency_ms);
+
+  const int nready = poll(fds, nfds, timeout_ms);
+  if (g_stop_requested) {
+    return OnlineWaitResult::Interrupted;
+  }
+  if (nready > 0 && state.watch_stdin && (fds[stdin_slot].revents & (POLLIN | POLLHUP))) {
+    const int input = read_quit_input();
+    if (input > 0) {
+      return OnlineWaitResult::Quit;
+    }
+    if (input < 0) {
+      state.watch_stdin = false;  // stdin closed: stop waking up on it
+    }
+  }
+  return OnlineWaitResult::Timeout;
+}
+
+void reset_online_wait(OnlineWaitState &state) {
+  state.backoff_ms = 1;
+}
+
+constexpr int kMaxSamples = 4096;
+
+struct WftreeOutput {
+  TTree *tree = nullptr;
+  TH1I *h_adc_dist = nullptr;
+  TH1I *h_amplitude = nullptr;
+  TH1I *h_nsample = nullptr;
+  Int_t evtn = 0;
+  Int_t det = 0;
+  Int_t ch = 0;
+  Int_t nsample = 0;
+  Short_t wf[kMaxSamples];
+  Short_t wf_min = 0;
+  Short_t wf_max = 0;
+  Float_t wf_mean = 0.0f;
+  // h_adc_dist is accumulated here (bin = ADC + 2048) and flushed on write
+  std::vector<unsigned int> adc_counts = std::vector<unsigned int>(4096, 0);
+  long long adc_entries = 0;
+  double adc_sumx = 0.0;
+  double adc_sumx2 = 0.0;
+
+  int basket_size = 32000;
+  Long64_t auto_flush = 0;
+  bool store_waveforms = true;  // false: no wftree (--no-waveforms)
+  bool pack = false;            // wfpk (WaveformCodec.h) instead of wf
+  Int_t nwfpk = 0;
+  std::vector<UChar_t> wfpk;
+  bool analyze = false;
+  AnalysisTreeOutput analysis;
+  bool crop = false;  // --suppress: crop_start branch
+  Int_t crop_start = 0;
+  Long64_t filled_bytes = 0;  // uncompressed bytes passed to wftree Fill (--roll-size)
+
+  // event schema: channels of the current event, written by finish_wftree_event
+  WftreeSchema schema = WftreeSchema::Channel;
+  Int_t nch = 0;
+  Int_t nwf = 0;
+  std::vector<Int_t> ev_det;
+  std::vector<Int_t> ev_ch;
+  std::vector<Int_t> ev_nsample;
+  std::vector<Int_t> ev_offset;
+  std::vector<Short_t> ev_wf_min;
+  std::vector<Short_t> ev_wf_max;
+  std::vector<Float_t> ev_wf_mean;
+  std::vector<Short_t> ev_wf;
+  std::vector<Int_t> ev_pkoffset;
+  std::vector<Int_t> ev_crop_start;
+};
 
-  if (online_mode) {
-    p->online(infile.c_str());
-    std::cout << "Online mode: connecting to " << infile << std::endl;
+struct ConversionStats {
+  int raw_evt_count = 0;
+  int shown_evt_count = 0;
+  int total_segments = 0;
+  int total_samples = 0;
+  int skipped_ch_out_of_range = 0;
+  std::vector<int> source_events;  // shown events per online host
+  int analyzed = 0;
+  int analysis_invalid = 0;
+  int suppressed = 0;  // --suppress: channels dropped / cropped
+  int cropped = 0;
+};
+
+// Point the event schema branches at the per-event buffers (they move when
+// the buffers grow)
+void bind_event_branches(WftreeOutput &out) {
+  out.tree->SetBranchAddress("det", out.ev_det.data());
+  out.tree->SetBranchAddress("ch", out.ev_ch.data());
+  out.tree->SetBranchAddress("nsample", out.ev_nsample.data());
+  out.tree->SetBranchAddress("offset", out.ev_offset.data());
+  out.tree->SetBranchAddress("wf_min", out.ev_wf_min.data());
+  out.tree->SetBranchAddress("wf_max", out.ev_wf_max.data());
+  out.tree->SetBranchAddress("wf_mean", out.ev_wf_mean.data());
+  if (out.pack) {
+    out.tree->SetBranchAddress("pkoffset", out.ev_pkoffset.data());
+    out.tree->SetBranchAddress("wfpk", out.wfpk.data());
   } else {
-    if (p->file(infile.c_str()) < 0) {
-      std::cerr << "Error: Cannot open file " << infile << std::endl;
-      delete p;
-      return;
+    out.tree->SetBranchAddress("wf", out.ev_wf.data());
+  }
+  if (out.crop) {
+    out.tree->SetBranchAddress("crop_start", out.ev_crop_start.data());
+  }
+}
+
+// nwf samples (plain) or npk bytes (packed) for the whole event
+void reserve_event_buffers(WftreeOutput &out, size_t nch, size_t nwf, size_t npk) {
+  bool moved = false;
+  if (nch > out.ev_det.size()) {
+    const size_t n = std::max(nch, 2 * out.ev_det.size());
+    out.ev_det.resize(n);
+    out.ev_ch.resize(n);
+    out.ev_nsample.resize(n);
+    out.ev_offset.resize(n);
+    out.ev_wf_min.resize(n);
+    out.ev_wf_max.resize(n);
+    out.ev_wf_mean.resize(n);
+    out.ev_pkoffset.resize(n);
+    out.ev_crop_start.resize(n);
+    moved = true;
+  }
+  if (!out.pack && nwf > out.ev_wf.size()) {
+    out.ev_wf.resize(std::max(nwf, 2 * out.ev_wf.size()));
+    moved = true;
+  }
+  if (out.pack && npk > out.wfpk.size()) {
+    out.wfpk.resize(std::max(npk, 2 * out.wfpk.size()));
+    moved = true;
+  }
+  if (moved && out.tree != nullptr) {
+    bind_event_branches(out);
+  }
+}
+
+void create_wftree_output(WftreeOutput &out) {
+  const int bufsize = out.basket_size;
+  out.filled_bytes = 0;
+  if (out.analyze) {
+    createAnalysisTree(out.analysis);
+    if (out.auto_flush != 0) {
+      out.analysis.tree->SetAutoFlush(out.auto_flush);
+    }
+  }
+  if (!out.store_waveforms) {
+    out.tree = nullptr;
+  } else if (out.schema == WftreeSchema::Event) {
+    reserve_event_buffers(out, 64, 64 * kMaxSamples, 64 * waveformCodecMaxBytes(kMaxSamples));
+    out.tree = new TTree("wftree", "Waveform Tree (one entry per event)");
+    out.tree->Branch("evtn", &out.evtn, "evtn/I", bufsize);
+    out.tree->Branch("nch", &out.nch, "nch/I", bufsize);
+    out.tree->Branch("det", out.ev_det.data(), "det[nch]/I", bufsize);
+    out.tree->Branch("ch", out.ev_ch.data(), "ch[nch]/I", bufsize);
+    out.tree->Branch("nsample", out.ev_nsample.data(), "nsample[nch]/I", bufsize);
+    out.tree->Branch("offset", out.ev_offset.data(), "offset[nch]/I", bufsize);
+    out.tree->Branch("wf_min", out.ev_wf_min.data(), "wf_min[nch]/S", bufsize);
+    out.tree->Branch("wf_max", out.ev_wf_max.data(), "wf_max[nch]/S", bufsize);
+    out.tree->Branch("wf_mean", out.ev_wf_mean.data(), "wf_mean[nch]/F", bufsize);
+    out.tree->Branch("nwf", &out.nwf, "nwf/I", bufsize);
+    if (out.pack) {
+      out.tree->Branch("pkoffset", out.ev_pkoffset.data(), "pkoffset[nch]/I", bufsize);
+      out.tree->Branch("nwfpk", &out.nwfpk, "nwfpk/I", bufsize);
+      out.tree->Branch("wfpk", out.wfpk.data(), "wfpk[nwfpk]/b", bufsize);
+    } else {
+      out.tree->Branch("wf", out.ev_wf.data(), "wf[nwf]/S", bufsize);
+    }
+    if (out.crop) {
+      out.tree->Branch("crop_start", out.ev_crop_start.data(), "crop_start[nch]/I", bufsize);
+    }
+  } else {
+    out.tree = new TTree("wftree", "Waveform Tree");
+    out.tree->Branch("evtn", &out.evtn, "evtn/I", bufsize);
+    out.tree->Branch("det", &out.det, "det/I", bufsize);
+    out.tree->Branch("ch", &out.ch, "ch/I", bufsize);
+    out.tree->Branch("nsample", &out.nsample, "nsample/I", bufsize);
+    if (out.pack) {
+      out.wfpk.resize(waveformCodecMaxBytes(kMaxSamples));
+      out.tree->Branch("nwfpk", &out.nwfpk, "nwfpk/I", bufsize);
+      out.tree->Branch("wfpk", out.wfpk.data(), "wfpk[nwfpk]/b", bufsize);
+    } else {
+      out.tree->Branch("wf", out.wf, "wf[nsample]/S", bufsize);
+    }
+    out.tree->Branch("wf_min", &out.wf_min, "wf_min/S", bufsize);
+    out.tree->Branch("wf_max", &out.wf_max, "wf_max/S", bufsize);
+    out.tree->Branch("wf_mean", &out.wf_mean, "wf_mean/F", bufsize);
+    if (out.crop) {
+      out.tree->Branch("crop_start", &out.crop_start, "crop_start/I", bufsize);
     }
   }
 
-  // TFile을 루프 시작 전에 열기 (AutoSave 지원)
-  TFile *fout = new TFile(outfile.c_str(), "RECREATE");
-  if (!fout || fout->IsZombie()) {
-    std::cerr << "Error: Cannot create output file " << outfile << std::endl;
-    p->close();
-    delete p;
-    if (fout) delete fout;
+  if (out.tree != nullptr && out.auto_flush != 0) {
+    out.tree->SetAutoFlush(out.auto_flush);
+  }
+
+  out.h_adc_dist = new TH1I("h_adc_dist", "ADC Distribution;ADC;Counts", 4096, -2048, 2048);
+  out.h_amplitude = new TH1I("h_amplitude", "Amplitude Distribution;Amplitude;Counts", 4096, 0, 4096);
+  out.h_nsample = new TH1I("h_nsample", "Number of Samples;Samples;Counts", 5000, 0, 5000);
+}
+
+// out.evtn/det/ch/nsample/wf must be set and the samples already counted in
+// out.adc_counts before calling
+void fill_wftree_output(WftreeOutput &out, const c16_stats &st) {
+  out.wf_min = st.min;
+  out.wf_max = st.max;
+  out.wf_mean = static_cast<Float_t>(st.sum) / out.nsample;
+  out.adc_entries += out.nsample;
+  out.adc_sumx += static_cast<double>(st.sum);
+  out.adc_sumx2 += static_cast<double>(st.sumsq);
+
+  int amplitude = out.wf_max - out.wf_min;
+  out.h_amplitude->Fill(amplitude);
+  out.h_nsample->Fill(out.nsample);
+
+  if (out.tree == nullptr) {
+    return;
+  }
+  if (out.schema == WftreeSchema::Event) {
+    // event schema: collected until finish_wftree_event
+    reserve_event_buffers(out, out.nch + 1, out.nwf + out.nsample,
+                          out.nwfpk + waveformCodecMaxBytes(out.nsample));
+    const int i = out.nch++;
+    out.ev_det[i] = out.det;
+    out.ev_ch[i] = out.ch;
+    out.ev_nsample[i] = out.nsample;
+    out.ev_offset[i] = out.nwf;
+    out.ev_wf_min[i] = out.wf_min;
+    out.ev_wf_max[i] = out.wf_max;
+    out.ev_wf_mean[i] = out.wf_mean;
+    out.ev_crop_start[i] = out.crop_start;
+    if (out.pack) {
+      out.ev_pkoffset[i] = out.nwfpk;
+      out.nwfpk += static_cast<Int_t>(encodeWaveform(out.wf, out.nsample, out.wfpk.data() + out.nwfpk));
+    } else {
+      std::memcpy(out.ev_wf.data() + out.nwf, out.wf, sizeof(Short_t) * out.nsample);
+    }
+    out.nwf += out.nsample;
+    return;
+  }
+  if (out.pack) {
+    out.nwfpk = static_cast<Int_t>(encodeWaveform(out.wf, out.nsample, out.wfpk.data()));
+  }
+  out.filled_bytes += out.tree->Fill();
+}
+
+// Called after the last channel of an event. Events without any stored
+// channel are not written, as in the channel schema.
+void finish_wftree_event(WftreeOutput &out) {
+  if (out.schema != WftreeSchema::Event || out.tree == nullptr || out.nch == 0) {
+    return;
+  }
+  out.filled_bytes += out.tree->Fill();
+  out.nch = 0;
+  out.nwf = 0;
+  out.nwfpk = 0;
+}
+
+// analysis_tree entry for the waveform last passed to fill_wftree_output;
+// nsample is the length of the analyzed (uncropped) waveform
+void fill_analysis_output(WftreeOutput &out, int nsample, const WaveformAnalysisResult &result,
+                          ConversionStats &stats) {
+  fillAnalysisTree(out.analysis, out.evtn, out.det, out.ch, nsample, result);
+  stats.analyzed++;
+  if (!result.valid) {
+    stats.analysis_invalid++;
+  }
+}
+
+void autosave_output(WftreeOutput &out) {
+  if (out.tree != nullptr) {
+    out.tree->AutoSave("SaveSelf");
+  }
+  if (out.analysis.tree != nullptr) {
+    out.analysis.tree->AutoSave("SaveSelf");
+  }
+}
+
+// Move the accumulated ADC counts into h_adc_dist. Every 12-bit sample falls
+// inside the histogram range, so the stats are the plain sample moments.
+void flush_adc_counts(WftreeOutput &out) {
+  for (int b = 0; b < 4096; b++) {
+    out.h_adc_dist->SetBinContent(b + 1, out.adc_counts[b]);
+  }
+  double hstats[4] = {static_cast<double>(out.adc_entries), static_cast<double>(out.adc_entries),
+                      out.adc_sumx, out.adc_sumx2};
+  out.h_adc_dist->SetEntries(static_cast<double>(out.adc_entries));
+  out.h_adc_dist->PutStats(hstats);
+}
+
+void write_wftree_output(WftreeOutput &out) {
+  flush_adc_counts(out);
+  if (out.tree != nullptr) {
+    out.tree->Write();
+  }
+  if (out.analysis.tree != nullptr) {
+    out.analysis.tree->Write();
+  }
+  out.h_adc_dist->Write();
+  out.h_amplitude->Write();
+  out.h_nsample->Write();
+}
+
+// Online rate and data-loss accounting. Gaps in the RIDF block numbers
+// (per source) count blocks that were never analyzed, whether babinfo
+// moved on between two polls or the pipeline dropped them; gaps in the
+// event numbers do the same for events. One ratetree entry per interval.
+struct RateMonitor {
+  TTree *tree = nullptr;
+  TH1I *h_blkn_gap = nullptr;
+  TH1I *h_evtn_gap = nullptr;
+  double interval_s = 10.0;
+  std::chrono::steady_clock::time_point start;
+  std::chrono::steady_clock::time_point last_report;
+  std::vector<long long> last_blkn;  // per source, -1 = none yet
+  std::vector<long long> last_evtn;
+
+  long long blocks = 0;
+  long long blocks_missed = 0;
+  long long events = 0;
+  long long events_missed = 0;
+  long long bytes = 0;
+  long long prev_blocks = 0;  // totals at the previous report
+  long long prev_blocks_missed = 0;
+  long long prev_events = 0;
+  long long prev_events_missed = 0;
+  long long prev_bytes = 0;
+
+  // ratetree branches (values of one interval)
+  Double_t t = 0;
+  Double_t dt = 0;
+  Long64_t n_blocks = 0;
+  Long64_t n_blocks_missed = 0;
+  Long64_t n_events = 0;
+  Long64_t n_events_missed = 0;
+  Double_t evt_rate = 0;
+  Double_t mb_rate = 0;
+  Double_t daq_evt_rate = 0;
+  Double_t sampled_frac = 0;
+};
+
+// ratetree and gap histograms in the current directory
+void create_rate_outputs(RateMonitor &rm) {
+  rm.tree = new TTree("ratetree", "Online rate and data-loss per report interval");
+  rm.tree->Branch("t", &rm.t, "t/D");
+  rm.tree->Branch("dt", &rm.dt, "dt/D");
+  rm.tree->Branch("blocks", &rm.n_blocks, "blocks/L");
+  rm.tree->Branch("blocks_missed", &rm.n_blocks_missed, "blocks_missed/L");
+  rm.tree->Branch("events", &rm.n_events, "events/L");
+  rm.tree->Branch("events_missed", &rm.n_events_missed, "events_missed/L");
+  rm.tree->Branch("evt_rate", &rm.evt_rate, "evt_rate/D");
+  rm.tree->Branch("mb_rate", &rm.mb_rate, "mb_rate/D");
+  rm.tree->Branch("daq_evt_rate", &rm.daq_evt_rate, "daq_evt_rate/D");
+  rm.tree->Branch("sampled_frac", &rm.sampled_frac, "sampled_frac/D");
+
+  rm.h_blkn_gap = new TH1I("h_blkn_gap", "Missed blocks per gap;Missed blocks;Gaps", 100, 1, 101);
+  rm.h_evtn_gap = new TH1I("h_evtn_gap", "Missed events per gap;Missed events;Gaps", 1000, 1, 1001);
+}
+
+void create_rate_monitor(RateMonitor &rm, double interval_s) {
+  rm.interval_s = interval_s;
+  rm.start = std::chrono::steady_clock::now();
+  rm.last_report = rm.start;
+  create_rate_outputs(rm);
+}
+
+long long &rate_slot(std::vector<long long> &last, int src) {
+  const size_t i = static_cast<size_t>(src < 0 ? 0 : src);
+  if (i >= last.size()) {
+    last.resize(i + 1, -1);
+  }
+  return last[i];
+}
+
+// blkn = -1: block without block-number chunk (no gap accounting)
+void rate_on_block(RateMonitor &rm, int src, int blkn, int bytes) {
+  rm.blocks++;
+  rm.bytes += bytes;
+  if (blkn < 0) {
     return;
   }
-  fout->cd();  // gDirectory를 명시적으로 설정
-
-  TTree *tree = new TTree("wftree", "Waveform Tree");
-  Int_t evtn, det, ch, nsample;
-  Short_t wf[4096];
-  Short_t wf_min, wf_max;
-  Float_t wf_mean;
-
-  tree->Branch("evtn", &evtn, "evtn/I");
-  tree->Branch("det", &det, "det/I");
-  tree->Branch("ch", &ch, "ch/I");
-  tree->Branch("nsample", &nsample, "nsample/I");
-  tree->Branch("wf", wf, "wf[nsample]/S");
-  tree->Branch("wf_min", &wf_min, "wf_min/S");
-  tree->Branch("wf_max", &wf_max, "wf_max/S");
-  tree->Branch("wf_mean", &wf_mean, "wf_mean/F");
-
-  TH1I *h_adc_dist = new TH1I("h_adc_dist", "ADC Distribution;ADC;Counts", 4096, -2048, 2048);
-  TH1I *h_amplitude = new TH1I("h_amplitude", "Amplitude Distribution;Amplitude;Counts", 4096, 0, 4096);
-  TH1I *h_nsample = new TH1I("h_nsample", "Number of Samples;Samples;Counts", 5000, 0, 5000);
+  long long &last = rate_slot(rm.last_blkn, src);
+  // a smaller number means a new run: restart the sequence
+  if (last >= 0 && blkn > last + 1) {
+    rm.blocks_missed += blkn - last - 1;
+    rm.h_blkn_gap->Fill(static_cast<double>(blkn - last - 1));
+  }
+  last = blkn;
+}
+
+void rate_on_event(RateMonitor &rm, int src, int evtn) {
+  rm.events++;
+  long long &last = rate_slot(rm.last_evtn, src);
+  if (last >= 0 && evtn > last + 1) {
+    rm.events_missed += evtn - last - 1;
+    rm.h_evtn_gap->Fill(static_cast<double>(evtn - last - 1));
+  }
+  last = evtn;
+}
+
+// Print and store one interval when it is due (or when forced at the end)
+void rate_report(RateMonitor &rm, bool force) {
+  const auto now = std::chrono::steady_clock::now();
+  const double dt = std::chrono::duration<double>(now - rm.last_report).count();
+  if (dt <= 0 || (!force && dt < rm.interval_s)) {
+    return;
+  }
+
+  rm.t = std::chrono::duration<double>(now - rm.start).count();
+  rm.dt = dt;
+  rm.n_blocks = rm.blocks - rm.prev_blocks;
+  rm.n_blocks_missed = rm.blocks_missed - rm.prev_blocks_missed;
+  rm.n_events = rm.events - rm.prev_events;
+  rm.n_events_missed = rm.events_missed - rm.prev_events_missed;
+  rm.evt_rate = rm.n_events / dt;
+  rm.mb_rate = (rm.bytes - rm.prev_bytes) / (1024.0 * 1024.0) / dt;
+  rm.daq_evt_rate = (rm.n_events + rm.n_events_missed) / dt;
+  rm.sampled_frac =
+      (rm.n_events + rm.n_events_missed) > 0 ? static_cast<double>(rm.n_events) / (rm.n_events + rm.n_events_missed) : 1.0;
+  rm.tree->Fill();
+
+  std::cout << "\n[Rate] t=" << Form("%.1f", rm.t) << " s: " << Form("%.1f", rm.evt_rate) << " evt/s, "
+            << Form("%.2f", rm.mb_rate) << " MB/s, blocks " << rm.n_blocks << " (+" << rm.n_blocks_missed
+            << " missed), events " << rm.n_events << " (+" << rm.n_events_missed << " missed), sampled "
+            << Form("%.1f", 100.0 * rm.sampled_frac) << "% of " << Form("%.1f", rm.daq_evt_rate)
+            << " DAQ evt/s" << std::endl;
+
+  rm.prev_blocks = rm.blocks;
+  rm.prev_blocks_missed = rm.blocks_missed;
+  rm.prev_events = rm.events;
+  rm.prev_events_missed = rm.events_missed;
+  rm.prev_bytes = rm.bytes;
+  rm.last_report = now;
+}
+
+void print_rate_summary(const RateMonitor &rm) {
+  const long long daq_blocks = rm.blocks + rm.blocks_missed;
+  const long long daq_events = rm.events + rm.events_missed;
+  std::cout << "Data loss: " << rm.blocks << "/" << daq_blocks << " blocks and " << rm.events << "/" << daq_events
+            << " events analyzed ("
+            << Form("%.1f", daq_events > 0 ? 100.0 * rm.events / daq_events : 100.0) << "% sampled)" << std::endl;
+}
+
+void write_rate_monitor(RateMonitor &rm) {
+  rm.tree->Write();
+  rm.h_blkn_gap->Write();
+  rm.h_evtn_gap->Write();
+}
+
+// Rolling output (--roll-events/--roll-size/--roll-time): the output is split
+// into <name>_partNNN.root files. A finished part is written and closed on a
+// background writer thread while filling goes on in the next part.
+struct OutputRoller {
+  std::string stem;  // output file name without ".root"
+  long long roll_events = 0;
+  long long roll_bytes = 0;
+  double roll_seconds = 0;
+  int part = -1;
+  long long part_events = 0;
+  std::chrono::steady_clock::time_point part_start;
+  TFile *file = nullptr;
+  int compression = ROOT::RCompressionSetting::EDefaults::kUseCompiledDefault;
+  std::vector<std::string> names;
+
+  std::thread writer;
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::deque<std::function<void()>> jobs;
+  bool writer_done = false;
+};
+
+void run_output_writer(OutputRoller &roller) {
+  while (true) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(roller.mtx);
+      roller.cv.wait(lock, [&] { return roller.writer_done || !roller.jobs.empty(); });
+      if (roller.jobs.empty()) {
+        return;
+      }
+      job = std::move(roller.jobs.front());
+      roller.jobs.pop_front();
+    }
+    job();
+  }
+}
+
+// Open the next part and make it the current directory of this thread
+TFile *open_output_part(OutputRoller &roller) {
+  roller.part++;
+  const std::string name = roller.stem + Form("_part%03d.root", roller.part);
+  TFile *file = new TFile(name.c_str(), "RECREATE", "", roller.compression);
+  if (!file || file->IsZombie()) {
+    std::cerr << "Error: Cannot create output file " << name << std::endl;
+    delete file;
+    return nullptr;
+  }
+  file->cd();
+  roller.file = file;
+  roller.names.push_back(name);
+  roller.part_events = 0;
+  roller.part_start = std::chrono::steady_clock::now();
+  return file;
+}
+
+bool output_rolling(const AnalyzerOptions &options) {
+  return options.roll_events > 0 || options.roll_size_mb > 0 || options.roll_time_s > 0;
+}
+
+void start_output_roller(OutputRoller &roller, const AnalyzerOptions &options) {
+  roller.stem = options.outfile;
+  const std::string ext = ".root";
+  if (roller.stem.size() > ext.size() &&
+      roller.stem.compare(roller.stem.size() - ext.size(), ext.size(), ext) == 0) {
+    roller.stem.erase(roller.stem.size() - ext.size());
+  }
+  roller.roll_events = options.roll_events;
+  roller.roll_bytes = static_cast<long long>(options.roll_size_mb * 1024 * 1024);
+  roller.roll_seconds = options.roll_time_s;
+  roller.compression = options.compression;
+  roller.writer = std::thread(run_output_writer, std::ref(roller));
+}
+
+// Hand the objects of the current part to the writer thread
+void post_output_part(OutputRoller &roller, TFile *file, WftreeOutput &out, RateMonitor *rate) {
+  auto finished = std::make_shared<WftreeOutput>();
+  finished->tree = out.tree;
+  finished->analysis.tree = out.analysis.tree;
+  finished->h_adc_dist = out.h_adc_dist;
+  finished->h_amplitude = out.h_amplitude;
+  finished->h_nsample = out.h_nsample;
+  finished->adc_counts.swap(out.adc_counts);
+  finished->adc_entries = out.adc_entries;
+  finished->adc_sumx = out.adc_sumx;
+  finished->adc_sumx2 = out.adc_sumx2;
+  out.adc_counts.assign(4096, 0);
+  out.adc_entries = 0;
+  out.adc_sumx = 0.0;
+  out.adc_sumx2 = 0.0;
+
+  TTree *rate_tree = nullptr;
+  TH1I *h_blkn_gap = nullptr;
+  TH1I *h_evtn_gap = nullptr;
+  if (rate != nullptr) {
+    rate_tree = rate->tree;
+    h_blkn_gap = rate->h_blkn_gap;
+    h_evtn_gap = rate->h_evtn_gap;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(roller.mtx);
+    roller.jobs.push_back([file, finished, rate_tree, h_blkn_gap, h_evtn_gap]() {
+      file->cd();
+      write_wftree_output(*finished);
+      if (rate_tree != nullptr) {
+        rate_tree->Write();
+        h_blkn_gap->Write();
+        h_evtn_gap->Write();
+      }
+      file->Close();
+      delete file;
+    });
+  }
+  roller.cv.notify_all();
+}
+
+// Compressed size of the entries not written to the file yet (up to one
+// auto-flush cluster): filled minus written bytes, at the tree's ratio so far
+double unwritten_tree_bytes(TTree *tree, Long64_t filled_bytes) {
+  if (tree == nullptr) {
+    return 0.0;
+  }
+  const double written = static_cast<double>(tree->GetTotBytes());
+  const double pending = std::max(0.0, static_cast<double>(filled_bytes) - written);
+  const double ratio = (written > 0.0) ? static_cast<double>(tree->GetZipBytes()) / written : 1.0;
+  return pending * ratio;
+}
+
+bool roll_output_due(const OutputRoller &roller, const WftreeOutput &out) {
+  if (roller.roll_events > 0 && roller.part_events >= roller.roll_events) {
+    return true;
+  }
+  if (roller.roll_bytes > 0) {
+    const double part_bytes = static_cast<double>(roller.file->GetEND()) +
+                              unwritten_tree_bytes(out.tree, out.filled_bytes) +
+                              unwritten_tree_bytes(out.analysis.tree, out.analysis.filled_bytes);
+    if (part_bytes >= static_cast<double>(roller.roll_bytes)) {
+      return true;
+    }
+  }
+  if (roller.roll_seconds > 0 &&
+      std::chrono::steady_clock::now() - roller.part_start >= std::chrono::duration<double>(roller.roll_seconds)) {
+    return true;
+  }
+  return false;
+}
+
+// Called after each filled event: switch to the next part when one of the
+// limits is reached. The new wftree keeps the branch buffers of out.
+void count_output_event(OutputRoller *roller, WftreeOutput &out, RateMonitor *rate) {
+  if (roller == nullptr) {
+    return;
+  }
+  roller->part_events++;
+  if (roller->file == nullptr || !roll_output_due(*roller, out)) {
+    return;
+  }
+
+  TFile *finished = roller->file;
+  if (open_output_part(*roller) == nullptr) {
+    // keep filling the open part; it is written at the end of the run
+    roller->roll_events = 0;
+    roller->roll_bytes = 0;
+    roller->roll_seconds = 0;
+    finished->cd();
+    std::cerr << "\nError: Cannot open the next output part; rolling is stopped and the rest of the run "
+              << "goes to " << roller->names.back() << std::endl;
+    return;
+  }
+  post_output_part(*roller, finished, out, rate);
+  create_wftree_output(out);
+  if (rate != nullptr) {
+    create_rate_outputs(*rate);
+  }
+  std::cout << "\n[Output] " << roller->names.back() << std::endl;
+}
+
+// Write the last part and wait for the writer thread
+void finish_output_roller(OutputRoller &roller, WftreeOutput *out, RateMonitor *rate) {
+  if (roller.file != nullptr && out != nullptr) {
+    post_output_part(roller, roller.file, *out, rate);
+    roller.file = nullptr;
+  }
+  {
+    std::lock_guard<std::mutex> lock(roller.mtx);
+    roller.writer_done = true;
+  }
+  roller.cv.notify_all();
+  if (roller.writer.joinable()) {
+    roller.writer.join();
+  }
+}
+
+// Per-host receiver and event counts of an online run
+void print_source_stats(RIDFParser *p, const ConversionStats &stats) {
+  for (int src = 0; src < p->nsource(); src++) {
+    ridfpull_stats st;
+    if (p->sourcestats(src, &st) < 0) {
+      continue;
+    }
+    const int nevt = (src < static_cast<int>(stats.source_events.size())) ? stats.source_events[src] : 0;
+    std::cout << "  [" << p->sourcename(src) << "] " << st.blocks << " blocks (" << st.skipped
+              << " skipped between polls), " << nevt << " events, "
+              << st.bytes / (1024 * 1024) << " MB, " << st.errors << " errors, " << st.reconnects
+              << " reconnects" << (st.connected ? "" : " (disconnected)") << std::endl;
+  }
+}
+
+// --suppress decision for one decoded waveform (full trace)
+SuppressionDecision suppress_decision(const AnalyzerOptions &options, int det, int ch, const Short_t *wf,
+                                      int nsample) {
+  return evaluateSuppression(wf, nsample, options.suppress_params.compiled(det, ch));
+}
+
+// Move the region of interest to the front of wf; st is recomputed for the
+// kept samples. Returns false if the whole waveform is kept.
+bool crop_waveform(const SuppressionDecision &decision, Short_t *wf, int &nsample, c16_stats &st) {
+  if (decision.crop_start == 0 && decision.crop_length == nsample) {
+    return false;
+  }
+  std::memmove(wf, wf + decision.crop_start, sizeof(Short_t) * decision.crop_length);
+  nsample = decision.crop_length;
+  c16_sample_stats(wf, nsample, nullptr, &st);
+  return true;
+}
+
+void count_adc_samples(WftreeOutput &out, const Short_t *wf, int nsample) {
+  for (int i = 0; i < nsample; i++) {
+    out.adc_counts[(wf[i] + 2048) & 0xfff]++;
+  }
+}
+
+void run_serial_conversion(RIDFParser *p, const AnalyzerOptions &options, WftreeOutput &out,
+                           ConversionStats &stats, RateMonitor *rate, OutputRoller *roller) {
   MonitorState monitor_state;
+  monitor_state.detach_hists = output_rolling(options);
+  OnlineWaitState wait_state;
+  wait_state.max_latency_ms = options.max_latency_ms;
+  wait_state.watch_stdin = options.enable_monitor;
 
   int flag, seg, data[4];
-  int total_segments = 0;
-  int total_samples = 0;
-  int skipped_ch_out_of_range = 0;
-  int raw_evt_count = 0;
-  int shown_evt_count = 0;
   bool stop_requested = false;
   const int autosave_interval = 1000;
-
-  std::cout << "Analysis start" << std::endl;
+  long long last_blockcount = 0;
+  WaveformScratch scratch;  // --analyze
 
   while (true) {
     // 종료 조건 체크
@@ -399,12 +1216,15 @@ void run_analysis(const std::string &infile, int maxevt, const std::string &outf
       break;
     }
     if (stop_requested) break;
-    if (maxevt > 0 && raw_evt_count >= maxevt) break;
+    if (options.maxevt > 0 && stats.raw_evt_count >= options.maxevt) break;
+    if (rate != nullptr) {
+      rate_report(*rate, false);
+    }
 
-    flag = p->nextevt(&evtn);
+    flag = p->nextevt(&out.evtn);
 
     if (flag == -2) {
-      if (online_mode) {
+      if (options.online_mode) {
         std::cout << "Connection lost or no more data." << std::endl;
       }
       break;  // EOF 또는 연결 종료
@@ -412,139 +1232,935 @@ void run_analysis(const std::string &infile, int maxevt, const std::string &outf
     if (flag == -3) break;  // 미연결
 
     if (flag == 1) {  // 데이터 없음
-      if (online_mode) {
+      if (options.online_mode) {
         gSystem->ProcessEvents();
-        usleep(100000);  // 100ms 대기
+        if (wait_for_online_data(wait_state) == OnlineWaitResult::Quit) {
+          stop_requested = true;
+        }
       }
       continue;
     }
 
-    raw_evt_count++;
+    if (flag == 0 && options.last_evtn >= 0 && out.evtn > options.last_evtn) break;
+    // --first filters every event like the -j path, not only the seekevt() start
+    // (evtn is not always increasing in the file)
+    if (flag == 0 && options.first_evtn >= 0 && out.evtn < options.first_evtn) continue;
+
+    if (flag == 0 && rate != nullptr) {
+      if (p->blockcount() != last_blockcount) {
+        last_blockcount = p->blockcount();
+        rate_on_block(*rate, p->blocksource(), p->blocknumber(), p->blocksize());
+      }
+      rate_on_event(*rate, p->blocksource(), out.evtn);
+    }
+
+    reset_online_wait(wait_state);
+    stats.raw_evt_count++;
     if (flag) continue;
-    shown_evt_count++;
+    stats.shown_evt_count++;
+    if (options.online_mode) {
+      const size_t src = static_cast<size_t>(p->blocksource());
+      if (src >= stats.source_events.size()) {
+        stats.source_events.resize(src + 1, 0);
+      }
+      stats.source_events[src]++;
+    }
 
     EventWaveforms event_waveforms;
 
     while (!p->nextseg(&seg)) {
-      det = p->segdet(seg);
-      ch = p->segfp(seg);
-      total_segments++;
-
-      int idx = 0;
-      while (p->nextdata(seg, data) >= 0) {
-        if (idx < 4096) {
-          const Short_t raw = static_cast<Short_t>(data[3]);
-          wf[idx++] = static_cast<Short_t>(raw >> 4);
+      out.det = p->segdet(seg);
+      out.ch = p->segfp(seg);
+      stats.total_segments++;
+
+      // samples of skipped channels are not counted in h_adc_dist; with
+      // --suppress only the stored samples are, after the crop
+      const bool ch_in_range = (out.ch >= 0 && out.ch <= 7);
+      unsigned int *counts = (ch_in_range && !options.suppress) ? out.adc_counts.data() : nullptr;
+      c16_stats st;
+
+      int nraw = 0;
+      const unsigned short *raw = p->segdata(&nraw);
+      if (raw != nullptr) {
+        out.nsample = std::min(nraw, kMaxSamples);
+        c16_unpack_stats(raw, out.nsample, out.wf, counts, &st);
+      } else {
+        // no 16-bit view for this module: per-word decoder path
+        int idx = 0;
+        while (p->nextdata(seg, data) >= 0) {
+          if (idx < kMaxSamples) {
+            const Short_t word = static_cast<Short_t>(data[3]);
+            out.wf[idx++] = static_cast<Short_t>(word >> 4);
+          }
         }
+        out.nsample = idx;
+        c16_sample_stats(out.wf, out.nsample, counts, &st);
       }
-      nsample = idx;
-      total_samples += nsample;
+      stats.total_samples += out.nsample;
 
-      if (nsample == 0) {
+      if (out.nsample == 0) {
         continue;
       }
-      if (ch < 0 || ch > 7) {
-        skipped_ch_out_of_range++;
+      if (!ch_in_range) {
+        stats.skipped_ch_out_of_range++;
         continue;
       }
 
-      wf_min = 32767;
-      wf_max = -32768;
-      float sum = 0;
-
-      for (int i = 0; i < nsample; i++) {
-        if (wf[i] < wf_min)
-          wf_min = wf[i];
-        if (wf[i] > wf_max)
-          wf_max = wf[i];
-        sum += wf[i];
-        h_adc_dist->Fill(wf[i]);
+      SuppressionDecision zs;
+      if (options.suppress) {
+        zs = suppress_decision(options, out.det, out.ch, out.wf, out.nsample);
+        if (!zs.keep) {
+          stats.suppressed++;
+          continue;
+        }
+      }
+      // the analysis always sees the full trace
+      const int analyzed_nsample = out.nsample;
+      WaveformAnalysisResult result;
+      if (options.analyze) {
+        result = analyzeWaveform(out.wf, out.nsample, options.analysis_params.compiled(out.det, out.ch), scratch);
+      }
+      if (options.suppress) {
+        out.crop_start = zs.crop_start;
+        if (crop_waveform(zs, out.wf, out.nsample, st)) {
+          stats.cropped++;
+        }
+        count_adc_samples(out, out.wf, out.nsample);
       }
-      wf_mean = sum / nsample;
-
-      int amplitude = wf_max - wf_min;
-      h_amplitude->Fill(amplitude);
-      h_nsample->Fill(nsample);
 
-      tree->Fill();
+      fill_wftree_output(out, st);
+      if (options.analyze) {
+        fill_analysis_output(out, analyzed_nsample, result, stats);
+      }
 
-      if (enable_monitor) {
-        event_waveforms[det][ch].assign(wf, wf + nsample);
+      if (options.enable_monitor) {
+        event_waveforms[out.det][out.ch].assign(out.wf, out.wf + out.nsample);
       }
     }
 
-    if (enable_monitor) {
-      update_event_monitor(monitor_state, event_waveforms, layout_mode, evtn);
-      if (online_mode) {
+    finish_wftree_event(out);
+    count_output_event(roller, out, rate);
+
+    if (options.enable_monitor) {
+      update_event_monitor(monitor_state, event_waveforms, options.layout_mode, out.evtn);
+      if (options.online_mode) {
         // 온라인 GUI: 비차단 입력 체크 + 자동 진행
-        std::cout << "\r[Online] Event " << shown_evt_count
-                  << " (evtn=" << evtn << ") - type 'q'+Enter to quit" << std::flush;
+        std::cout << "\r[Online] Event " << stats.shown_evt_count
+                  << " (evtn=" << out.evtn << ") - type 'q'+Enter to quit" << std::flush;
         if (check_quit_input()) {
           stop_requested = true;
         }
       } else {
         // 파일 GUI: 기존 Enter 대기
-        if (!wait_for_monitor_input(shown_evt_count, evtn)) {
+        if (!wait_for_monitor_input(stats.shown_evt_count, out.evtn)) {
           stop_requested = true;
         }
       }
     }
 
-    // 온라인 모드: 주기적 저장
-    if (online_mode && (shown_evt_count % autosave_interval) == 0) {
-      tree->AutoSave("SaveSelf");
-      std::cout << "\n[AutoSave] " << shown_evt_count << " events saved" << std::endl;
+    // 온라인 모드: 주기적 저장 (rolling output: the open part)
+    if (options.online_mode && (stats.shown_evt_count % autosave_interval) == 0) {
+      autosave_output(out);
+      std::cout << "\n[AutoSave] " << stats.shown_evt_count << " events saved" << std::endl;
+      if (p->nsource() > 1) {
+        print_source_stats(p, stats);
+      }
     }
 
-    if (!online_mode && (shown_evt_count % 1000) == 0) {
-      std::cout << "Processing shown event " << shown_evt_count << " (evtn=" << evtn << ")" << std::endl;
+    if (!options.online_mode && (stats.shown_evt_count % 1000) == 0) {
+      std::cout << "Processing shown event " << stats.shown_evt_count << " (evtn=" << out.evtn << ")"
+                << std::endl;
     }
   }
+}
+
+// Block-parallel conversion: decoded waveforms of one RIDF block
+struct WaveformRecord {
+  Int_t det = 0;
+  Int_t ch = 0;
+  Int_t nsample = 0;
+  c16_stats st;
+  size_t offset = 0;  // first sample in WaveformBatch::samples
+  Int_t crop_start = 0;  // --suppress only
+  Int_t analyzed_nsample = 0;
+  WaveformAnalysisResult result;  // --analyze only
+};
+
+struct EventRecords {
+  Int_t evtn = 0;
+  int first_record = 0;
+  int nrecords = 0;
+  int nsegments = 0;
+  int nsamples = 0;
+  int skipped_ch_out_of_range = 0;
+  int suppressed = 0;
+  int cropped = 0;
+};
+
+struct WaveformBatch {
+  int blkn = -1;  // block number chunk, -1 = none
+  int size = 0;   // block size in bytes
+  std::vector<EventRecords> events;
+  std::vector<WaveformRecord> records;
+  std::vector<Short_t> samples;
+};
+
+// Decoders registered without a 16-bit sample view keep their decode
+// position in the shared instance; segments of such modules are decoded one
+// worker at a time.
+std::mutex decoder_mutex;
+
+// Same sample unpacking as the serial path: modules whose registered decoder
+// has a 16-bit sample view are unpacked from it (ModuleAbst::samples() keeps
+// no state), other registered decoders go through decode() word by word like
+// RIDFParser::nextdata(), and modules without a decoder give raw 32-bit words.
+int unpack_segment_samples(RIDFParser *p, char *segbuf, int ssz, int mod, Short_t *wf,
+                           c16_stats &st) {
+  int idx = 0;
+  int nraw = 0;
+  ModuleAbst *dec = p->getdecoder(mod);
+  const unsigned short *raw = (dec != nullptr) ? dec->samples(segbuf, ssz, &nraw) : nullptr;
+  if (raw != nullptr) {
+    idx = std::min(nraw, kMaxSamples);
+    c16_unpack_stats(raw, idx, wf, nullptr, &st);
+    return idx;
+  }
+
+  if (dec != nullptr) {
+    std::lock_guard<std::mutex> lock(decoder_mutex);
+    int data[4];
+    dec->reset();
+    while (dec->decode(segbuf, ssz, data) >= 0) {
+      if (idx < kMaxSamples) {
+        const Short_t word = static_cast<Short_t>(data[3]);
+        wf[idx++] = static_cast<Short_t>(word >> 4);
+      }
+    }
+  } else {
+    for (int off = 0; off < ssz; off += 4) {
+      int word;
+      std::memcpy(&word, segbuf + off, sizeof(word));
+      if (idx < kMaxSamples) {
+        const Short_t raw = static_cast<Short_t>(word);
+        wf[idx++] = static_cast<Short_t>(raw >> 4);
+      }
+    }
+  }
+  c16_sample_stats(wf, idx, nullptr, &st);
+  return idx;
+}
 
+// Decode all events of one block, following the event/segment walk of
+// RIDFParser::nextevtdata() and nextseg().
+void decode_block(RIDFParser *p, char *blk, int sz, const AnalyzerOptions &options, WaveformBatch &batch) {
+  int nidx = 0, sidx = 0, nsidx = 0, evtn = 0, segid = 0;
+  unsigned long long int ts = 0;
+  Short_t wf[kMaxSamples];
+  c16_stats st;
+  static thread_local WaveformScratch scratch;  // --analyze, one per decode thread
+
+  batch.blkn = p->getblkn(blk, sz);
+  batch.size = sz;
+
+  int n = 8;
+  while ((n = p->getevtindex(blk, n, sz, &nidx, &sidx, &evtn, &ts)) >= 0) {
+    if (options.first_evtn < 0 || evtn >= options.first_evtn) {
+      EventRecords ev;
+      ev.evtn = evtn;
+      ev.first_record = static_cast<int>(batch.records.size());
+
+      while ((sidx = p->getsegindex(blk, sidx, sz, &nsidx, &segid)) >= 0) {
+        const int ssz = nsidx - sidx - 12;
+        int nsample = unpack_segment_samples(p, blk + sidx + 12, ssz, p->segmod(segid), wf, st);
+        const int ch = p->segfp(segid);
+        ev.nsegments++;
+        ev.nsamples += nsample;
+        sidx = nsidx;
+
+        if (nsample == 0) {
+          continue;
+        }
+        if (ch < 0 || ch > 7) {
+          ev.skipped_ch_out_of_range++;
+          continue;
+        }
+
+        WaveformRecord rec;
+        rec.det = p->segdet(segid);
+        rec.ch = ch;
+        SuppressionDecision zs;
+        if (options.suppress) {
+          zs = suppress_decision(options, rec.det, ch, wf, nsample);
+          if (!zs.keep) {
+            ev.suppressed++;
+            continue;
+          }
+        }
+        rec.analyzed_nsample = nsample;
+        if (options.analyze) {
+          // analyzed on the decode thread while the samples are still in cache
+          rec.result = analyzeWaveform(wf, nsample, options.analysis_params.compiled(rec.det, ch), scratch);
+        }
+        if (options.suppress) {
+          rec.crop_start = zs.crop_start;
+          if (crop_waveform(zs, wf, nsample, st)) {
+            ev.cropped++;
+          }
+        }
+        rec.nsample = nsample;
+        rec.offset = batch.samples.size();
+        rec.st = st;
+        batch.samples.insert(batch.samples.end(), wf, wf + nsample);
+        batch.records.push_back(rec);
+        ev.nrecords++;
+      }
+      batch.events.push_back(ev);
+    }
+
+    if (nidx >= sz - 4) {
+      break;
+    }
+    n = nidx;
+  }
+}
+
+// Fill wftree and the histograms with one decoded event
+void fill_event_records(WftreeOutput &out, const WaveformBatch &batch, const EventRecords &ev,
+                        ConversionStats &stats) {
+  stats.raw_evt_count++;
+  stats.shown_evt_count++;
+  stats.total_segments += ev.nsegments;
+  stats.total_samples += ev.nsamples;
+  stats.skipped_ch_out_of_range += ev.skipped_ch_out_of_range;
+  stats.suppressed += ev.suppressed;
+  stats.cropped += ev.cropped;
+
+  out.evtn = ev.evtn;
+  for (int r = ev.first_record; r < ev.first_record + ev.nrecords; r++) {
+    const WaveformRecord &rec = batch.records[r];
+    out.det = rec.det;
+    out.ch = rec.ch;
+    out.nsample = rec.nsample;
+    out.crop_start = rec.crop_start;
+    std::memcpy(out.wf, batch.samples.data() + rec.offset, sizeof(Short_t) * rec.nsample);
+    count_adc_samples(out, out.wf, out.nsample);
+    fill_wftree_output(out, rec.st);
+    if (out.analyze) {
+      fill_analysis_output(out, rec.analyzed_nsample, rec.result, stats);
+    }
+  }
+  finish_wftree_event(out);
+}
+
+// Worker threads decode blocks found by a header-only scan; this thread
+// writes the batches to wftree strictly in block order.
+void run_parallel_conversion(RIDFParser *p, const AnalyzerOptions &options, WftreeOutput &out,
+                             ConversionStats &stats, OutputRoller *roller) {
+  int nblk = 0;
+  long long *offsets = p->scanblocks(&nblk);
+  if (offsets == nullptr) {
+    std::cerr << "Error: Cannot scan blocks of " << options.infile << std::endl;
+    return;
+  }
+  std::cout << "Parallel conversion: " << nblk << " blocks, " << options.jobs << " workers" << std::endl;
+
+  const int window = options.jobs * 4;  // max blocks decoded ahead of the writer
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::map<int, WaveformBatch> ready;
+  std::atomic<int> next_task{0};
+  int next_write = 0;
+  bool abort = false;
+
+  auto worker = [&]() {
+    std::vector<char> buff(1024 * 1024);
+    while (true) {
+      const int k = next_task++;
+      if (k >= nblk) {
+        return;
+      }
+      {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [&] { return abort || k < next_write + window; });
+        if (abort) {
+          return;
+        }
+      }
+
+      WaveformBatch batch;
+      char *blk = nullptr;
+      const int sz = p->readblockat(offsets[k], buff.data(), &blk);
+      if (sz > 0) {
+        decode_block(p, blk, sz, options, batch);
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        ready[k] = std::move(batch);
+      }
+      cv.notify_all();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < options.jobs; i++) {
+    workers.emplace_back(worker);
+  }
+
+  bool stop = false;
+  for (int k = 0; k < nblk && !stop; k++) {
+    WaveformBatch batch;
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      cv.wait(lock, [&] { return ready.count(k) > 0; });
+      batch = std::move(ready[k]);
+      ready.erase(k);
+      next_write = k + 1;
+    }
+    cv.notify_all();
+
+    for (const EventRecords &ev : batch.events) {
+      if (g_stop_requested) {
+        std::cout << "\nSIGINT received. Stopping..." << std::endl;
+        stop = true;
+        break;
+      }
+      if (options.maxevt > 0 && stats.raw_evt_count >= options.maxevt) {
+        stop = true;
+        break;
+      }
+      if (options.last_evtn >= 0 && ev.evtn > options.last_evtn) {
+        stop = true;
+        break;
+      }
+
+      fill_event_records(out, batch, ev, stats);
+      count_output_event(roller, out, nullptr);
+
+      if ((stats.shown_evt_count % 1000) == 0) {
+        std::cout << "Processing shown event " << stats.shown_evt_count << " (evtn=" << out.evtn << ")"
+                  << std::endl;
+      }
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    abort = true;
+  }
+  cv.notify_all();
+  for (std::thread &t : workers) {
+    t.join();
+  }
+  free(offsets);
+}
+
+// Online pipeline: receive -> decode -> fill/write threads and the display on
+// the main thread, connected by bounded SPSC queues. The receiver never waits
+// on the later stages: a block that finds the decode queue full is dropped
+// and counted, and a full display queue only skips a monitor update.
+struct OnlineBlock {
+  std::vector<char> data;
+  int size = 0;
+  int source = 0;
+};
+
+struct DecodedBlock {
+  WaveformBatch batch;
+  int source = 0;
+};
+
+struct MonitorEvent {
+  int evtn = 0;
+  int shown_evt_count = 0;
+  EventWaveforms waveforms;
+};
+
+struct OnlinePipeline {
+  SPSCQueue<OnlineBlock> blocks{64};               // receive -> decode
+  SPSCQueue<std::vector<char>> free_buffers{64};   // decode -> receive (buffer reuse)
+  SPSCQueue<DecodedBlock> batches{16};             // decode -> fill
+  SPSCQueue<MonitorEvent> display{4};              // fill -> display
+  std::atomic<bool> stop{false};
+  std::atomic<bool> receive_done{false};
+  std::atomic<bool> decode_done{false};
+  std::atomic<bool> fill_done{false};
+  std::atomic<bool> connection_lost{false};
+  std::atomic<long long> received_blocks{0};
+  std::atomic<long long> dropped_blocks{0};
+  std::atomic<long long> skipped_displays{0};
+};
+
+void print_pipeline_status(OnlinePipeline &pl) {
+  std::cout << "  [Pipeline] queues: blocks " << pl.blocks.size() << "/" << pl.blocks.capacity()
+            << ", batches " << pl.batches.size() << "/" << pl.batches.capacity() << ", display "
+            << pl.display.size() << "/" << pl.display.capacity() << "; " << pl.received_blocks
+            << " blocks received, " << pl.dropped_blocks << " dropped (decode queue full)" << std::endl;
+}
+
+// Idle wait of a stage whose input queue is empty (or output queue full)
+void pipeline_idle(int &idle_us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(idle_us));
+  idle_us = std::min(idle_us * 2, 1000);
+}
+
+void pipeline_receive(RIDFParser *p, const AnalyzerOptions &options, OnlinePipeline &pl) {
+  OnlineWaitState wait_state;
+  wait_state.max_latency_ms = options.max_latency_ms;
+
+  while (!pl.stop && !g_stop_requested) {
+    char *blk = nullptr;
+    const int sz = p->nextblock(&blk);
+    if (sz < 0) {
+      pl.connection_lost = true;
+      break;
+    }
+    if (sz == 0) {
+      wait_for_online_data(wait_state);
+      continue;
+    }
+    reset_online_wait(wait_state);
+    pl.received_blocks++;
+
+    OnlineBlock block;
+    pl.free_buffers.try_pop(block.data);
+    block.data.assign(blk, blk + sz);
+    block.size = sz;
+    block.source = p->blocksource();
+    if (!pl.blocks.try_push(std::move(block))) {
+      pl.dropped_blocks++;
+    }
+  }
+  pl.receive_done = true;
+}
+
+void pipeline_decode(RIDFParser *p, const AnalyzerOptions &options, OnlinePipeline &pl) {
+  int idle_us = 50;
+  OnlineBlock block;
+
+  while (!pl.stop) {
+    const bool producer_done = pl.receive_done;
+    if (!pl.blocks.try_pop(block)) {
+      if (producer_done) {
+        break;
+      }
+      pipeline_idle(idle_us);
+      continue;
+    }
+    idle_us = 50;
+
+    DecodedBlock decoded;
+    decoded.source = block.source;
+    decode_block(p, block.data.data(), block.size, options, decoded.batch);
+    pl.free_buffers.try_push(std::move(block.data));
+
+    while (!pl.batches.try_push(std::move(decoded))) {
+      if (pl.stop) {
+        break;
+      }
+      pipeline_idle(idle_us);
+    }
+  }
+  pl.decode_done = true;
+}
+
+void pipeline_fill(RIDFParser *p, const AnalyzerOptions &options, WftreeOutput &out, ConversionStats &stats,
+                   RateMonitor *rate, OutputRoller *roller, OnlinePipeline &pl) {
+  const int autosave_interval = 1000;
+  int idle_us = 50;
+  DecodedBlock decoded;
+
+  while (!pl.stop) {
+    if (rate != nullptr) {
+      rate_report(*rate, false);
+    }
+    const bool producer_done = pl.decode_done;
+    if (!pl.batches.try_pop(decoded)) {
+      if (producer_done) {
+        break;
+      }
+      pipeline_idle(idle_us);
+      continue;
+    }
+    idle_us = 50;
+
+    const WaveformBatch &batch = decoded.batch;
+    if (rate != nullptr) {
+      rate_on_block(*rate, decoded.source, batch.blkn, batch.size);
+    }
+    for (const EventRecords &ev : batch.events) {
+      if (options.maxevt > 0 && stats.raw_evt_count >= options.maxevt) {
+        pl.stop = true;
+        break;
+      }
+      if (options.last_evtn >= 0 && ev.evtn > options.last_evtn) {
+        pl.stop = true;
+        break;
+      }
+
+      fill_event_records(out, batch, ev, stats);
+      if (rate != nullptr) {
+        rate_on_event(*rate, decoded.source, ev.evtn);
+      }
+      const size_t src = static_cast<size_t>(decoded.source);
+      if (src >= stats.source_events.size()) {
+        stats.source_events.resize(src + 1, 0);
+      }
+      stats.source_events[src]++;
+      count_output_event(roller, out, rate);
+
+      // 온라인 모드: 주기적 저장 (fill thread, 수신은 계속됨)
+      if ((stats.shown_evt_count % autosave_interval) == 0) {
+        autosave_output(out);
+        std::cout << "\n[AutoSave] " << stats.shown_evt_count << " events saved" << std::endl;
+        print_pipeline_status(pl);
+        if (p->nsource() > 1) {
+          print_source_stats(p, stats);
+        }
+      }
+    }
+
+    // only the last event of a block is drawn
+    if (options.enable_monitor && !batch.events.empty()) {
+      const EventRecords &ev = batch.events.back();
+      MonitorEvent mev;
+      mev.evtn = ev.evtn;
+      mev.shown_evt_count = stats.shown_evt_count;
+      for (int r = ev.first_record; r < ev.first_record + ev.nrecords; r++) {
+        const WaveformRecord &rec = batch.records[r];
+        const Short_t *wf = batch.samples.data() + rec.offset;
+        mev.waveforms[rec.det][rec.ch].assign(wf, wf + rec.nsample);
+      }
+      if (!pl.display.try_push(std::move(mev))) {
+        pl.skipped_displays++;
+      }
+    }
+  }
+  pl.fill_done = true;
+}
+
+void run_online_pipeline(RIDFParser *p, const AnalyzerOptions &options, WftreeOutput &out,
+                         ConversionStats &stats, RateMonitor *rate, OutputRoller *roller) {
+  OnlinePipeline pl;
+  MonitorState monitor_state;
+  monitor_state.detach_hists = true;
+  OnlineWaitState wait_state;
+  wait_state.max_latency_ms = options.max_latency_ms;
+  wait_state.watch_stdin = options.enable_monitor;
+
+  std::thread receiver(pipeline_receive, p, std::cref(options), std::ref(pl));
+  std::thread decoder(pipeline_decode, p, std::cref(options), std::ref(pl));
+  std::thread filler(pipeline_fill, p, std::cref(options), std::ref(out), std::ref(stats), rate,
+                     roller, std::ref(pl));
+
+  // display stage: ROOT graphics and stdin stay on the main thread
+  bool sigint_reported = false;
+  while (!pl.fill_done) {
+    if (g_stop_requested && !sigint_reported) {
+      std::cout << "\nSIGINT received. Stopping..." << std::endl;
+      sigint_reported = true;
+      pl.stop = true;
+    }
+
+    MonitorEvent mev;
+    bool have_event = false;
+    while (pl.display.try_pop(mev)) {
+      have_event = true;
+    }
+    if (have_event) {
+      update_event_monitor(monitor_state, mev.waveforms, options.layout_mode, mev.evtn);
+      std::cout << "\r[Online] Event " << mev.shown_evt_count << " (evtn=" << mev.evtn << ") queues "
+                << pl.blocks.size() << "/" << pl.batches.size() << "/" << pl.display.size()
+                << ", dropped " << pl.dropped_blocks << " - type 'q'+Enter to quit" << std::flush;
+      reset_online_wait(wait_state);
+    }
+    if (options.enable_monitor) {
+      gSystem->ProcessEvents();
+    }
+
+    if (pl.stop) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    } else if (wait_for_online_data(wait_state) == OnlineWaitResult::Quit) {
+      pl.stop = true;
+    }
+  }
+
+  pl.stop = true;
+  receiver.join();
+  decoder.join();
+  filler.join();
+
+  if (pl.connection_lost) {
+    std::cout << "\nConnection lost or no more data." << std::endl;
+  }
+  std::cout << "\nOnline pipeline: " << pl.received_blocks << " blocks received, " << pl.dropped_blocks
+            << " dropped (decode queue full), " << pl.skipped_displays << " monitor updates skipped"
+            << std::endl;
+}
+
+// --compress-bench: convert the first events of the input once, then fill
+// the same waveforms into an in-memory file for each compression setting
+// and report the time and size of wftree.
+int run_compression_benchmark(const AnalyzerOptions &options) {
+  RIDFParser *p = new RIDFParser();
+  if (p->file(options.infile.c_str()) < 0) {
+    std::cerr << "Error: Cannot open file " << options.infile << std::endl;
+    delete p;
+    return 1;
+  }
+  int nblk = 0;
+  long long *offsets = p->scanblocks(&nblk);
+  if (offsets == nullptr) {
+    std::cerr << "Error: Cannot scan blocks of " << options.infile << std::endl;
+    p->close();
+    delete p;
+    return 1;
+  }
+
+  std::vector<WaveformBatch> sample;
+  std::vector<char> buff(1024 * 1024);
+  int nevt = 0;
+  for (int k = 0; k < nblk && nevt < options.bench_events; k++) {
+    WaveformBatch batch;
+    char *blk = nullptr;
+    const int sz = p->readblockat(offsets[k], buff.data(), &blk);
+    if (sz > 0) {
+      decode_block(p, blk, sz, options, batch);
+    }
+    nevt += static_cast<int>(batch.events.size());
+    sample.push_back(std::move(batch));
+  }
+  free(offsets);
+  p->close();
+  delete p;
+
+  std::vector<std::pair<std::string, int>> settings = {
+      {"none", 0}, {"lz4:1", 0}, {"lz4:4", 0}, {"zlib:1", 0}, {"zlib:6", 0},
+      {"zstd:1", 0}, {"zstd:5", 0}, {"lzma:1", 0}};
+  if (!options.compression_spec.empty()) {
+    settings.insert(settings.begin(), {options.compression_spec, 0});
+  }
+  for (auto &s : settings) {
+    parse_compression(s.first, s.second);
+  }
+
+  std::cout << "Compression benchmark: " << nevt << " events, "
+            << (options.schema == WftreeSchema::Event ? "event" : "channel") << " layout"
+            << (options.pack_waveforms ? " (packed)" : "") << ", basket "
+            << options.basket_size << " B" << std::endl;
+  std::cout << Form("  %-10s %10s %10s %8s %10s", "setting", "raw MB", "zip MB", "ratio", "MB/s") << std::endl;
+
+  for (const auto &s : settings) {
+    TMemFile mem("compress_bench.root", "RECREATE", "", s.second);
+    mem.cd();
+    WftreeOutput bench_out;
+    bench_out.schema = options.schema;
+    bench_out.basket_size = options.basket_size;
+    bench_out.auto_flush = options.auto_flush;
+    bench_out.pack = options.pack_waveforms;
+    create_wftree_output(bench_out);
+    ConversionStats bench_stats;
+
+    const auto t0 = std::chrono::steady_clock::now();
+    for (const WaveformBatch &batch : sample) {
+      for (const EventRecords &ev : batch.events) {
+        fill_event_records(bench_out, batch, ev, bench_stats);
+      }
+    }
+    bench_out.tree->FlushBaskets();
+    const double dt = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    const double raw_mb = bench_out.tree->GetTotBytes() / (1024.0 * 1024.0);
+    const double zip_mb = bench_out.tree->GetZipBytes() / (1024.0 * 1024.0);
+    std::cout << Form("  %-10s %10.2f %10.2f %8.2f %10.1f", s.first.c_str(), raw_mb, zip_mb,
+                      zip_mb > 0 ? raw_mb / zip_mb : 0.0, dt > 0 ? raw_mb / dt : 0.0)
+              << std::endl;
+    mem.Close();
+  }
+  return 0;
+}
+
+void run_analysis(const AnalyzerOptions &options) {
+  RIDFParser *p = new RIDFParser();
+
+  if (options.online_mode) {
+    p->online(options.infile.c_str());
+    std::cout << "Online mode: connecting to " << options.infile << std::endl;
+  } else {
+    const int open_ret =
+        options.use_mmap ? p->mapfile(options.infile.c_str()) : p->file(options.infile.c_str());
+    if (open_ret < 0) {
+      std::cerr << "Error: Cannot open file " << options.infile << std::endl;
+      delete p;
+      return;
+    }
+    if (options.prefetch_blocks > 0 && p->prefetch(options.prefetch_blocks)) {
+      std::cout << "Block prefetch enabled: " << options.prefetch_blocks << " buffers" << std::endl;
+    }
+    if (options.first_evtn >= 0 && options.jobs <= 1) {
+      const int nindexed = p->useindex();
+      if (nindexed < 0) {
+        std::cerr << "Error: Cannot build event index for " << options.infile << std::endl;
+        p->close();
+        delete p;
+        return;
+      }
+      if (p->seekevt(options.first_evtn) < 0) {
+        std::cerr << "Error: No event with evtn >= " << options.first_evtn << " (" << nindexed
+                  << " events indexed)" << std::endl;
+        p->close();
+        delete p;
+        return;
+      }
+      std::cout << "Seek to evtn " << options.first_evtn << " using event index (" << nindexed
+                << " events)" << std::endl;
+    }
+  }
+
+  // TFile을 루프 시작 전에 열기 (AutoSave 지원)
+  OutputRoller roller_state;
+  OutputRoller *roller = nullptr;
+  TFile *fout = nullptr;
+  if (output_rolling(options)) {
+    start_output_roller(roller_state, options);
+    roller = &roller_state;
+    if (open_output_part(roller_state) == nullptr) {
+      finish_output_roller(roller_state, nullptr, nullptr);
+      p->close();
+      delete p;
+      return;
+    }
+  } else {
+    fout = new TFile(options.outfile.c_str(), "RECREATE", "", options.compression);
+    if (!fout || fout->IsZombie()) {
+      std::cerr << "Error: Cannot create output file " << options.outfile << std::endl;
+      p->close();
+      delete p;
+      if (fout) delete fout;
+      return;
+    }
+    fout->cd();  // gDirectory를 명시적으로 설정
+  }
+
+  WftreeOutput out;
+  out.schema = options.schema;
+  out.basket_size = options.basket_size;
+  out.auto_flush = options.auto_flush;
+  out.analyze = options.analyze;
+  out.crop = options.suppress;
+  out.store_waveforms = options.store_waveforms;
+  out.pack = options.pack_waveforms;
+  create_wftree_output(out);
+  ConversionStats stats;
+  RateMonitor rate_monitor;
+  RateMonitor *rate = nullptr;
+  if (options.online_mode && options.rate_interval_s > 0) {
+    create_rate_monitor(rate_monitor, options.rate_interval_s);
+    rate = &rate_monitor;
+  }
+
+  std::cout << "Analysis start (C16 unpack: " << c16_unpack_impl();
+  if (options.analyze) {
+    std::cout << ", analysis kernels: " << waveformKernelsImpl();
+  }
+  std::cout << ")" << std::endl;
+
+  if (options.online_mode && options.online_pipeline) {
+    run_online_pipeline(p, options, out, stats, rate, roller);
+  } else if (options.jobs > 1) {
+    run_parallel_conversion(p, options, out, stats, roller);
+  } else {
+    run_serial_conversion(p, options, out, stats, rate, roller);
+  }
+
+  std::cout << "\nAnalysis done: " << stats.shown_evt_count << " shown events ("
+            << stats.raw_evt_count << " raw events), " << stats.total_segments
+            << " segments, " << stats.total_samples << " total samples, "
+            << stats.skipped_ch_out_of_range << " segments skipped (ch outside 0-7)" << std::endl;
+  if (options.analyze) {
+    std::cout << "Waveform analysis: " << stats.analyzed << " waveforms in analysis_tree ("
+              << stats.analysis_invalid << " without a valid result)" << std::endl;
+  }
+  if (options.suppress) {
+    std::cout << "Zero suppression: " << stats.suppressed << " waveforms dropped, " << stats.cropped
+              << " cropped to the region of interest" << std::endl;
+  }
+  if (options.online_mode) {
+    print_source_stats(p, stats);
+  }
+  if (rate != nullptr) {
+    rate_report(*rate, true);
+    print_rate_summary(*rate);
+  }
   p->close();
-  std::cout << "\nAnalysis done: " << shown_evt_count << " shown events ("
-            << raw_evt_count << " raw events), " << total_segments
-            << " segments, " << total_samples << " total samples, "
-            << skipped_ch_out_of_range << " segments skipped (ch outside 0-7)" << std::endl;
 
   // 최종 저장
-  fout->cd();
-  tree->Write();
-  h_adc_dist->Write();
-  h_amplitude->Write();
-  h_nsample->Write();
-  fout->Close();
-  std::cout << "Output saved to " << outfile << std::endl;
+  if (roller != nullptr) {
+    finish_output_roller(roller_state, &out, rate);
+    std::cout << "Output saved to " << roller_state.names.size() << " part files:" << std::endl;
+    for (const std::string &name : roller_state.names) {
+      std::cout << "  " << name << std::endl;
+    }
+  } else {
+    fout->cd();
+    write_wftree_output(out);
+    if (rate != nullptr) {
+      write_rate_monitor(*rate);
+    }
+    fout->Close();
+    std::cout << "Output saved to " << options.outfile << std::endl;
+    delete fout;
+  }
 
   delete p;
-  delete fout;
 }
 
 int main(int argc, char *argv[]) {
-  std::string outfile = "rfsoc_ridf_analyzer_out.root";
-  int maxevt = 10000;
+  AnalyzerOptions options;
+  std::string analysis_config_path;
+  std::string suppress_config_path;
   bool batch_mode = false;
   bool all_det_in_one_canvas = false;
-  bool online_mode = false;
-  std::string infile;
 
   static struct option long_options[] = {{"output", required_argument, 0, 'o'},
                                           {"maxevt", required_argument, 0, 'n'},
                                           {"batch", no_argument, 0, 'b'},
                                           {"all", no_argument, 0, 'a'},
+                                          {"mmap", no_argument, 0, 'm'},
+                                          {"prefetch", required_argument, 0, 'p'},
+                                          {"first", required_argument, 0, 'F'},
+                                          {"last", required_argument, 0, 'L'},
+                                          {"jobs", required_argument, 0, 'j'},
                                           {"online", no_argument, 0, 'l'},
+                                          {"max-latency", required_argument, 0, 'M'},
+                                          {"no-pipeline", no_argument, 0, 'N'},
+                                          {"rate-interval", required_argument, 0, 'R'},
+                                          {"schema", required_argument, 0, 'W'},
+                                          {"compress", required_argument, 0, 'C'},
+                                          {"basket-size", required_argument, 0, 'K'},
+                                          {"auto-flush", required_argument, 0, 'A'},
+                                          {"cluster-size", required_argument, 0, 'Z'},
+                                          {"compress-bench", required_argument, 0, 'B'},
+                                          {"threads", required_argument, 0, 'X'},
+                                          {"pack-waveforms", no_argument, 0, 'Q'},
+                                          {"analyze", required_argument, 0, 'Y'},
+                                          {"no-waveforms", no_argument, 0, 'V'},
+                                          {"suppress", required_argument, 0, 'U'},
+                                          {"roll-events", required_argument, 0, 'E'},
+                                          {"roll-size", required_argument, 0, 'S'},
+                                          {"roll-time", required_argument, 0, 'T'},
                                           {"help", no_argument, 0, 'h'},
                                           {0, 0, 0, 0}};
 
   int opt;
   int option_index = 0;
-  while ((opt = getopt_long(argc, argv, "o:n:balh", long_options, &option_index)) != -1) {
+  while ((opt = getopt_long(argc, argv, "o:n:bamp:j:lh", long_options, &option_index)) != -1) {
     switch (opt) {
     case 'o':
-      outfile = optarg;
+      options.outfile = optarg;
       break;
     case 'n':
-      maxevt = std::atoi(optarg);
+      options.maxevt = std::atoi(optarg);
       break;
     case 'b':
       batch_mode = true;
@@ -552,8 +2168,86 @@ int main(int argc, char *argv[]) {
     case 'a':
       all_det_in_one_canvas = true;
       break;
+    case 'm':
+      options.use_mmap = true;
+      break;
+    case 'p':
+      options.prefetch_blocks = std::atoi(optarg);
+      break;
+    case 'F':
+      options.first_evtn = std::atoi(optarg);
+      break;
+    case 'L':
+      options.last_evtn = std::atoi(optarg);
+      break;
+    case 'j':
+      options.jobs = std::atoi(optarg);
+      break;
     case 'l':
-      online_mode = true;
+      options.online_mode = true;
+      break;
+    case 'M':
+      options.max_latency_ms = std::atoi(optarg);
+      break;
+    case 'N':
+      options.online_pipeline = false;
+      break;
+    case 'R':
+      options.rate_interval_s = std::atof(optarg);
+      break;
+    case 'W':
+      if (std::strcmp(optarg, "event") == 0) {
+        options.schema = WftreeSchema::Event;
+      } else if (std::strcmp(optarg, "channel") == 0) {
+        options.schema = WftreeSchema::Channel;
+      } else {
+        std::cerr << "Error: Unknown --schema " << optarg << " (channel or event)" << std::endl;
+        return 1;
+      }
+      break;
+    case 'C':
+      options.compression_spec = optarg;
+      if (!parse_compression(options.compression_spec, options.compression)) {
+        std::cerr << "Error: Unknown --compress " << optarg << " (none, zlib, lz4, zstd, lzma[:level])"
+                  << std::endl;
+        return 1;
+      }
+      break;
+    case 'K':
+      options.basket_size = std::atoi(optarg);
+      break;
+    case 'A':
+      options.auto_flush = std::atoll(optarg);
+      break;
+    case 'Z':
+      options.auto_flush = -static_cast<Long64_t>(std::atof(optarg) * 1024 * 1024);
+      break;
+    case 'B':
+      options.bench_events = std::atoi(optarg);
+      break;
+    case 'X':
+      options.threads = std::atoi(optarg);
+      break;
+    case 'Q':
+      options.pack_waveforms = true;
+      break;
+    case 'Y':
+      analysis_config_path = optarg;
+      break;
+    case 'V':
+      options.store_waveforms = false;
+      break;
+    case 'U':
+      suppress_config_path = optarg;
+      break;
+    case 'E':
+      options.roll_events = std::atoll(optarg);
+      break;
+    case 'S':
+      options.roll_size_mb = std::atof(optarg);
+      break;
+    case 'T':
+      options.roll_time_s = std::atof(optarg);
       break;
     case 'h':
       print_usage(argv[0]);
@@ -569,15 +2263,101 @@ int main(int argc, char *argv[]) {
     print_usage(argv[0]);
     return 1;
   }
-  infile = argv[optind];
+  options.infile = argv[optind];
 
   if (batch_mode && all_det_in_one_canvas) {
     std::cerr << "Warning: -a/--all is GUI-only and will be ignored in batch mode." << std::endl;
     all_det_in_one_canvas = false;
   }
 
-  if (online_mode) {
-    std::signal(SIGINT, sigint_handler);
+  if (options.online_mode && options.use_mmap) {
+    std::cerr << "Warning: -m/--mmap only applies to file input and will be ignored in online mode." << std::endl;
+    options.use_mmap = false;
+  }
+  if (options.prefetch_blocks > 0 && (options.online_mode || options.use_mmap)) {
+    std::cerr << "Warning: -p/--prefetch only applies to stdio file input and will be ignored." << std::endl;
+    options.prefetch_blocks = 0;
+  }
+  if (options.online_mode && options.first_evtn >= 0) {
+    std::cerr << "Warning: --first needs file input and will be ignored in online mode." << std::endl;
+    options.first_evtn = -1;
+  }
+
+  if (options.jobs > 1 && (options.online_mode || !batch_mode)) {
+    std::cerr << "Warning: -j/--jobs needs file input in batch mode; using a single thread." << std::endl;
+    options.jobs = 1;
+  }
+  if (options.jobs > 1 && options.prefetch_blocks > 0) {
+    std::cerr << "Warning: -p/--prefetch is not used with -j/--jobs (workers read blocks directly)." << std::endl;
+    options.prefetch_blocks = 0;
+  }
+
+  if (options.max_latency_ms < 1) {
+    std::cerr << "Warning: --max-latency must be at least 1 ms; using 1." << std::endl;
+    options.max_latency_ms = 1;
+  }
+
+  if (!analysis_config_path.empty()) {
+    AnalysisConfig config = makeDefaultAnalysisConfig();
+    std::string err;
+    if (!loadAnalysisConfig(analysis_config_path, config, &err)) {
+      std::cerr << "Error: " << err << std::endl;
+      return 1;
+    }
+    options.analysis_params.compile(config);
+    options.analyze = true;
+  }
+  if (!suppress_config_path.empty()) {
+    AnalysisConfig config = makeDefaultAnalysisConfig();
+    std::string err;
+    if (!loadAnalysisConfig(suppress_config_path, config, &err)) {
+      std::cerr << "Error: " << err << std::endl;
+      return 1;
+    }
+    options.suppress_params.compile(config);
+    options.suppress = true;
+  }
+  if (!options.store_waveforms && !options.analyze) {
+    std::cerr << "Warning: --no-waveforms needs --analyze; wftree is written." << std::endl;
+    options.store_waveforms = true;
+  }
+
+  if (options.basket_size < 1000) {
+    std::cerr << "Warning: --basket-size below 1000 bytes; using 1000." << std::endl;
+    options.basket_size = 1000;
+  }
+
+  if (options.threads > 0) {
+    // baskets of all wftree branches are compressed as parallel tasks when
+    // the tree flushes; RIDF parsing and filling stay on their threads
+    ROOT::EnableImplicitMT(options.threads);
+    if (ROOT::IsImplicitMTEnabled()) {
+      std::cout << "ROOT implicit MT: " << ROOT::GetThreadPoolSize() << " threads" << std::endl;
+    } else {
+      std::cerr << "Warning: ROOT was built without implicit MT; --threads is ignored." << std::endl;
+    }
+  }
+
+  if (options.bench_events > 0) {
+    if (options.online_mode) {
+      std::cerr << "Error: --compress-bench needs file input" << std::endl;
+      return 1;
+    }
+    gROOT->SetBatch(kTRUE);
+    return run_compression_benchmark(options);
+  }
+
+  if (output_rolling(options)) {
+    // finished parts are written and closed on the output writer thread
+    ROOT::EnableThreadSafety();
+  }
+
+  if (options.online_mode) {
+    install_sigint_handler();
+    if (options.online_pipeline) {
+      // wftree is filled and auto-saved on the fill thread while the monitor draws
+      ROOT::EnableThreadSafety();
+    }
     std::cout << "Online mode enabled. Use 'q'+Enter (GUI) or Ctrl+C (batch) to quit." << std::endl;
   }
 
@@ -590,9 +2370,10 @@ int main(int argc, char *argv[]) {
     gROOT->SetBatch(kTRUE);
   }
 
-  const MonitorLayoutMode layout_mode =
+  options.enable_monitor = !batch_mode;
+  options.layout_mode =
       all_det_in_one_canvas ? MonitorLayoutMode::AllDetSingleCanvas : MonitorLayoutMode::PerDetCanvas;
-  run_analysis(infile, maxevt, outfile, !batch_mode, layout_mode, online_mode);
+  run_analysis(options);
 
   if (!batch_mode) {
     std::cout << "GUI monitor finished." << std::endl;
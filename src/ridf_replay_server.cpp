@@ -0,0 +1,510 @@
+// ridf_replay_server.cpp - babinfo stand-in that replays a recorded RIDF file
+//
+// Speaks the request/reply protocol used by RIDFPull::eb_get() on the babinfo
+// port: the client sends (int len = 4, int command), the server answers
+// (int len, len bytes). INF_GET_BLOCKNUM returns the current block number,
+// INF_GET_RAWDATA the current block with its block-number chunk set to that
+// number. Blocks are published at a fixed block rate, a byte rate or in real
+// time from the event timestamps, optionally with injected gaps and stalls.
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <getopt.h>
+#include <iostream>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#include "RIDFParser.h"
+#include "ridf.h"
+
+namespace {
+
+constexpr int kInfComPort = 17516;  // babinfo communication port
+constexpr int kInfGetRawData = 10;
+constexpr int kInfGetBlockNum = 11;
+
+using Clock = std::chrono::steady_clock;
+
+volatile sig_atomic_t g_stop_requested = 0;
+
+void sigint_handler(int sig) {
+  (void)sig;
+  g_stop_requested = 1;
+}
+
+enum class PaceMode {
+  BlockRate = 0,
+  ByteRate = 1,
+  RealTime = 2
+};
+
+struct ReplayOptions {
+  std::string infile;
+  int port = kInfComPort;
+  PaceMode pace = PaceMode::BlockRate;
+  double block_rate = 10.0;   // blocks/s
+  double mb_rate = 0.0;       // MB/s
+  double ts_clock = 1e8;      // timestamp ticks per second
+  double speed = 1.0;         // real-time speed factor
+  bool loop = false;
+  int gap_every = 0;          // every N blocks ...
+  int gap_blocks = 1;         // ... drop M blocks
+  int stall_every = 0;        // every N blocks ...
+  int stall_ms = 1000;        // ... stop publishing for MS
+  double exit_after = -1.0;   // seconds after the last block, <0 = serve until Ctrl+C
+  bool verbose = false;
+};
+
+struct ReplayBlock {
+  const char *data = nullptr;
+  int size = 0;
+  unsigned long long ts = 0;  // first event timestamp, 0 = none
+};
+
+struct Client {
+  int fd = -1;
+  char req[8]{};
+  int nreq = 0;
+  std::vector<char> out;
+  size_t nout = 0;
+};
+
+struct ReplayStats {
+  long long published = 0;
+  long long dropped = 0;
+  long long stalls = 0;
+  long long blocknum_requests = 0;
+  long long rawdata_requests = 0;
+  long long bytes_sent = 0;
+  long long accepted = 0;
+};
+
+void print_usage(const char *progname) {
+  std::cout << "Usage: " << progname << " [OPTIONS] <input.ridf>\n"
+            << "Serve the blocks of a RIDF file like babinfo (for online tests of rfsoc_ridf_analyzer).\n"
+            << "Options:\n"
+            << "  -P, --port N          TCP port (default: 17516)\n"
+            << "  -r, --rate N          Publish N blocks/s (default: 10)\n"
+            << "  -B, --mbps X          Publish X MB/s instead of a block rate\n"
+            << "  -t, --realtime        Publish in real time from the event timestamps\n"
+            << "  --ts-clock HZ         Timestamp clock for --realtime (default: 1e8)\n"
+            << "  --speed X             Speed factor for --realtime (default: 1)\n"
+            << "  -L, --loop            Restart from the first block at end of file\n"
+            << "  --gap-every N         Drop blocks every N published blocks (block number jumps)\n"
+            << "  --gap-blocks M        Number of blocks dropped per gap (default: 1)\n"
+            << "  --stall-every N       Stop publishing every N published blocks\n"
+            << "  --stall-ms MS         Stall length (default: 1000)\n"
+            << "  --exit-after SEC      Exit SEC seconds after the last block (default: serve until Ctrl+C)\n"
+            << "  -v, --verbose         Print publish/request counters every second\n"
+            << "  -h, --help            Show this help\n";
+}
+
+// Header-only scan of the file, keeps pointers into the mapping
+bool load_blocks(RIDFParser *p, std::vector<ReplayBlock> &blocks) {
+  int nblk = 0;
+  long long *offsets = p->scanblocks(&nblk);
+  if (offsets == nullptr) {
+    return false;
+  }
+
+  for (int i = 0; i < nblk; i++) {
+    char *blk = nullptr;
+    const int sz = p->readblockat(offsets[i], nullptr, &blk);
+    if (sz <= 0) {
+      break;
+    }
+    ReplayBlock b;
+    b.data = blk;
+    b.size = sz;
+
+    int nidx = 0, sidx = 0, evtn = 0;
+    unsigned long long ts = 0;
+    if (p->getevtindex(blk, 8, sz, &nidx, &sidx, &evtn, &ts) >= 0) {
+      b.ts = ts;
+    }
+    blocks.push_back(b);
+  }
+  free(offsets);
+  return !blocks.empty();
+}
+
+// Copy of the block as babinfo would send it: the block-number chunk right
+// after the block header carries the server's counter (inserted if missing)
+void make_published_block(const ReplayBlock &b, int blkn, std::vector<char> &dest) {
+  int thd = 0;
+  std::memcpy(&thd, b.data + 8, sizeof(thd));
+  const bool has_blkn = (b.size >= 20 && RIDF_CI(thd) == 8);
+
+  if (has_blkn) {
+    dest.assign(b.data, b.data + b.size);
+  } else {
+    const int size = b.size + 12;
+    int hd[3];
+    dest.resize(size);
+    std::memcpy(&hd[0], b.data, sizeof(int));
+    hd[0] = RIDF_MKHD1(RIDF_LY(hd[0]), RIDF_CI(hd[0]), size / 2);
+    std::memcpy(dest.data(), &hd[0], sizeof(int));
+    std::memcpy(dest.data() + 4, b.data + 4, 4);
+    hd[1] = RIDF_MKHD1(1, 8, 6);
+    hd[2] = 0;
+    std::memcpy(dest.data() + 8, &hd[1], sizeof(int));
+    std::memcpy(dest.data() + 12, &hd[2], sizeof(int));
+    std::memcpy(dest.data() + 20, b.data + 8, b.size - 8);
+  }
+  std::memcpy(dest.data() + 16, &blkn, sizeof(blkn));
+}
+
+int open_listen_socket(int port) {
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    perror("socket");
+    return -1;
+  }
+  const int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+  struct sockaddr_in addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0 || listen(fd, 16) < 0) {
+    perror("bind/listen");
+    close(fd);
+    return -1;
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  return fd;
+}
+
+void queue_reply(Client &c, const char *data, int len) {
+  c.out.resize(sizeof(len) + len);
+  std::memcpy(c.out.data(), &len, sizeof(len));
+  if (len > 0) {
+    std::memcpy(c.out.data() + sizeof(len), data, len);
+  }
+  c.nout = 0;
+}
+
+// Read the request of a client, returns false when the client is gone
+bool handle_readable(Client &c, int blkn, const std::vector<char> &current, ReplayStats &stats) {
+  const ssize_t n = recv(c.fd, c.req + c.nreq, sizeof(c.req) - c.nreq, 0);
+  if (n <= 0) {
+    return n < 0 && (errno == EAGAIN || errno == EINTR);
+  }
+  c.nreq += static_cast<int>(n);
+  if (c.nreq < static_cast<int>(sizeof(c.req))) {
+    return true;
+  }
+  c.nreq = 0;
+
+  int len = 0, com = 0;
+  std::memcpy(&len, c.req, sizeof(len));
+  std::memcpy(&com, c.req + sizeof(len), sizeof(com));
+  if (len != static_cast<int>(sizeof(com))) {
+    return false;  // not the eb_get() protocol
+  }
+
+  if (com == kInfGetBlockNum) {
+    stats.blocknum_requests++;
+    queue_reply(c, reinterpret_cast<const char *>(&blkn), sizeof(blkn));
+  } else if (com == kInfGetRawData) {
+    stats.rawdata_requests++;
+    queue_reply(c, current.data(), static_cast<int>(current.size()));
+  } else {
+    queue_reply(c, nullptr, 0);
+  }
+  return true;
+}
+
+bool handle_writable(Client &c, ReplayStats &stats) {
+  const ssize_t n = send(c.fd, c.out.data() + c.nout, c.out.size() - c.nout, MSG_NOSIGNAL);
+  if (n < 0) {
+    return errno == EAGAIN || errno == EINTR;
+  }
+  c.nout += static_cast<size_t>(n);
+  stats.bytes_sent += n;
+  if (c.nout == c.out.size()) {
+    c.out.clear();
+    c.nout = 0;
+  }
+  return true;
+}
+
+// Time between publishing block i and the next one
+double block_interval(const ReplayOptions &options, const std::vector<ReplayBlock> &blocks, size_t i) {
+  switch (options.pace) {
+  case PaceMode::ByteRate:
+    return blocks[i].size / (options.mb_rate * 1024.0 * 1024.0);
+  case PaceMode::RealTime: {
+    const size_t next = i + 1;
+    if (next >= blocks.size() || blocks[i].ts == 0 || blocks[next].ts <= blocks[i].ts) {
+      return 0.0;
+    }
+    return (blocks[next].ts - blocks[i].ts) / options.ts_clock / options.speed;
+  }
+  default:
+    return 1.0 / options.block_rate;
+  }
+}
+
+int run_server(const ReplayOptions &options) {
+  RIDFParser *p = new RIDFParser();
+  if (p->mapfile(options.infile.c_str()) < 0) {
+    std::cerr << "Error: Cannot open file " << options.infile << std::endl;
+    delete p;
+    return 2;
+  }
+  std::vector<ReplayBlock> blocks;
+  if (!load_blocks(p, blocks)) {
+    std::cerr << "Error: No blocks in " << options.infile << std::endl;
+    delete p;
+    return 2;
+  }
+
+  const int lfd = open_listen_socket(options.port);
+  if (lfd < 0) {
+    delete p;
+    return 1;
+  }
+  std::cout << "Serving " << blocks.size() << " blocks of " << options.infile << " on port " << options.port
+            << std::endl;
+
+  std::vector<Client> clients;
+  ReplayStats stats;
+  std::vector<char> current;
+  int blkn = 0;
+  size_t iblk = 0;
+  bool at_end = false;
+  int since_gap = 0;
+  int since_stall = 0;
+
+  make_published_block(blocks[0], blkn, current);
+  stats.published++;
+  Clock::time_point next_publish =
+      Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                         std::chrono::duration<double>(block_interval(options, blocks, 0)));
+  Clock::time_point end_time;
+  Clock::time_point next_report = Clock::now() + std::chrono::seconds(1);
+
+  while (!g_stop_requested) {
+    const Clock::time_point now = Clock::now();
+
+    // publish the next block(s) that are due
+    while (!at_end && now >= next_publish) {
+      int step = 1;
+      since_gap++;
+      since_stall++;
+      if (options.gap_every > 0 && since_gap >= options.gap_every) {
+        step += options.gap_blocks;
+        stats.dropped += options.gap_blocks;
+        since_gap = 0;
+      }
+
+      double wait = 0.0;
+      for (int s = 0; s < step && !at_end; s++) {
+        wait += block_interval(options, blocks, iblk);
+        iblk++;
+        if (iblk >= blocks.size()) {
+          if (options.loop) {
+            iblk = 0;
+          } else {
+            at_end = true;
+            end_time = now;
+            std::cout << "End of file after " << stats.published << " published blocks" << std::endl;
+          }
+        }
+      }
+      if (at_end) {
+        break;
+      }
+
+      blkn += step;
+      make_published_block(blocks[iblk], blkn, current);
+      stats.published++;
+
+      if (options.stall_every > 0 && since_stall >= options.stall_every) {
+        wait += options.stall_ms / 1000.0;
+        stats.stalls++;
+        since_stall = 0;
+      }
+      next_publish += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(wait));
+    }
+
+    if (at_end && options.exit_after >= 0 &&
+        now - end_time >= std::chrono::duration<double>(options.exit_after)) {
+      break;
+    }
+
+    if (options.verbose && now >= next_report) {
+      std::cout << "[replay] blkn=" << blkn << " published=" << stats.published << " dropped=" << stats.dropped
+                << " stalls=" << stats.stalls << " clients=" << clients.size()
+                << " blocknum_req=" << stats.blocknum_requests << " rawdata_req=" << stats.rawdata_requests
+                << " sent=" << stats.bytes_sent / (1024 * 1024) << " MB" << std::endl;
+      next_report += std::chrono::seconds(1);
+    }
+
+    std::vector<struct pollfd> fds;
+    fds.push_back({lfd, POLLIN, 0});
+    for (const Client &c : clients) {
+      fds.push_back({c.fd, static_cast<short>(c.out.empty() ? POLLIN : POLLOUT), 0});
+    }
+
+    int timeout_ms = 100;
+    if (!at_end) {
+      const auto until = std::chrono::duration_cast<std::chrono::milliseconds>(next_publish - now).count();
+      timeout_ms = static_cast<int>(std::max<long long>(0, std::min<long long>(until, timeout_ms)));
+    }
+    if (poll(fds.data(), fds.size(), timeout_ms) <= 0) {
+      continue;
+    }
+
+    for (size_t i = clients.size(); i-- > 0;) {
+      const short rev = fds[i + 1].revents;
+      bool keep = true;
+      if (rev & POLLOUT) {
+        keep = handle_writable(clients[i], stats);
+      } else if (rev & POLLIN) {
+        keep = handle_readable(clients[i], blkn, current, stats);
+      } else if (rev & (POLLERR | POLLHUP | POLLNVAL)) {
+        keep = false;
+      }
+      if (!keep) {
+        close(clients[i].fd);
+        clients.erase(clients.begin() + i);
+      }
+    }
+
+    if (fds[0].revents & POLLIN) {
+      int cfd;
+      while ((cfd = accept(lfd, nullptr, nullptr)) >= 0) {
+        fcntl(cfd, F_SETFL, fcntl(cfd, F_GETFL) | O_NONBLOCK);
+        Client c;
+        c.fd = cfd;
+        clients.push_back(c);
+        stats.accepted++;
+      }
+    }
+  }
+
+  for (const Client &c : clients) {
+    close(c.fd);
+  }
+  close(lfd);
+
+  std::cout << "Replay done: " << stats.published << " blocks published (last blkn=" << blkn << "), "
+            << stats.dropped << " dropped, " << stats.stalls << " stalls, " << stats.accepted << " connections, "
+            << stats.blocknum_requests << " block-number and " << stats.rawdata_requests << " raw-data requests, "
+            << stats.bytes_sent / (1024 * 1024) << " MB sent" << std::endl;
+
+  p->close();
+  delete p;
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  ReplayOptions options;
+
+  static struct option long_options[] = {{"port", required_argument, 0, 'P'},
+                                          {"rate", required_argument, 0, 'r'},
+                                          {"mbps", required_argument, 0, 'B'},
+                                          {"realtime", no_argument, 0, 't'},
+                                          {"ts-clock", required_argument, 0, 'C'},
+                                          {"speed", required_argument, 0, 'S'},
+                                          {"loop", no_argument, 0, 'L'},
+                                          {"gap-every", required_argument, 0, 'g'},
+                                          {"gap-blocks", required_argument, 0, 'G'},
+                                          {"stall-every", required_argument, 0, 's'},
+                                          {"stall-ms", required_argument, 0, 'T'},
+                                          {"exit-after", required_argument, 0, 'x'},
+                                          {"verbose", no_argument, 0, 'v'},
+                                          {"help", no_argument, 0, 'h'},
+                                          {0, 0, 0, 0}};
+
+  int opt;
+  int option_index = 0;
+  while ((opt = getopt_long(argc, argv, "P:r:B:tLvh", long_options, &option_index)) != -1) {
+    switch (opt) {
+    case 'P':
+      options.port = std::atoi(optarg);
+      break;
+    case 'r':
+      options.pace = PaceMode::BlockRate;
+      options.block_rate = std::atof(optarg);
+      break;
+    case 'B':
+      options.pace = PaceMode::ByteRate;
+      options.mb_rate = std::atof(optarg);
+      break;
+    case 't':
+      options.pace = PaceMode::RealTime;
+      break;
+    case 'C':
+      options.ts_clock = std::atof(optarg);
+      break;
+    case 'S':
+      options.speed = std::atof(optarg);
+      break;
+    case 'L':
+      options.loop = true;
+      break;
+    case 'g':
+      options.gap_every = std::atoi(optarg);
+      break;
+    case 'G':
+      options.gap_blocks = std::atoi(optarg);
+      break;
+    case 's':
+      options.stall_every = std::atoi(optarg);
+      break;
+    case 'T':
+      options.stall_ms = std::atoi(optarg);
+      break;
+    case 'x':
+      options.exit_after = std::atof(optarg);
+      break;
+    case 'v':
+      options.verbose = true;
+      break;
+    case 'h':
+      print_usage(argv[0]);
+      return 0;
+    default:
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (optind >= argc) {
+    std::cerr << "Error: Input file required" << std::endl;
+    print_usage(argv[0]);
+    return 1;
+  }
+  options.infile = argv[optind];
+
+  if ((options.pace == PaceMode::BlockRate && options.block_rate <= 0) ||
+      (options.pace == PaceMode::ByteRate && options.mb_rate <= 0) ||
+      (options.pace == PaceMode::RealTime && (options.ts_clock <= 0 || options.speed <= 0))) {
+    std::cerr << "Error: publish rate must be positive" << std::endl;
+    return 1;
+  }
+  if (options.gap_blocks < 1) {
+    options.gap_blocks = 1;
+  }
+
+  std::signal(SIGINT, sigint_handler);
+  std::signal(SIGTERM, sigint_handler);
+  return run_server(options);
+}